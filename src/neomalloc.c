@@ -1,662 +1,2695 @@
-/*
- * Name:        neomalloc.c
- * Description: Neo malloc core function.
- * Author:      cosh.cage#hotmail.com
- * File ID:     1207250701A1207250923L00662
- * License:     LGPLv3
- * Copyright (C) 2025 John Cage
- *
- * This file is part of Neo Malloc.
- *
- * Neo Malloc is free software: you can redistribute it and/or modify it under
- * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
- * either version 3 of the License, or (at your option) any later version.
- *
- * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
- * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
- * See the GNU Lesser General Public License for more details.
- *
- * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
- * If not, see <https://www.gnu.org/licenses/>.
- *
- */
-
-#include "neomalloc.h"
-#include <limits.h>  /* Using macro CHAR_BIT. */
-#include <string.h>  /* Using function memcpy, memset. */
-
-#ifdef _MSC_VER
-#include <intrin.h>  /* Use function __lzcnt16, __lzcnt and __lzcnt64. */
-#endif
-
-/* [HEAP MEMORY DIAGRAM]
- * +=HEAP_HEADER=+
- * |size         *===>sizeof(chunk) == head note + free chunk + data + foot note.
- * |-------------|
- * |hshsiz:3     |
- * +=============+
- * |   POINTER   *>-------\    Big chunks.
- * |-------------|        V
- * |   POINTER   *-->NULL |
- * |-------------|        |
- * |   POINTER   *-->NULL |    Small chunks.
- * +=============+--------|--------\
- * |Head_note    |        V        |
- * +=FREE_CHUNK==+<-------/<--\    |
- * | p[FCP_PREV] *>-----------/    |
- * |-------------|            ^    |
- * | p[FCP_NEXT] *>-----------/    > This is a free chunk.
- * +=============+                 |
- * |    DATA     *==sizeof(size_t) |
- * |             |  *4             |
- * |             |                 |
- * |             |                 |
- * +=============+        /--------/
- * |Foot_note    |        |
- * +=============+--------/
- */
-
-/* sizeof(UCHART) == 1. */
-typedef unsigned char * PUCHAR;
-typedef unsigned char   UCHART;
-
-/* Chunk pointer indices. */
-enum en_FreeChunkPointer
-{
-	FCP_PREV = 0,
-	FCP_NEXT = 1,
-	FCP_MAX  = 2
-};
-
-/* Used and unused mark. */
-#define USED false
-#define FREE true
-
-/* Free chunk linked list node. */
-typedef struct st_FreeChunk
-{
-	struct st_FreeChunk * p[FCP_MAX];
-} FREE_CHUNK, * P_FREE_CHUNK;
-
-/* Usable macros. */
-#define MIN_CHUNK_SIZE (sizeof(size_t) * 2 + sizeof(FREE_CHUNK))
-#define HEAP_BEGIN(ph) (sizeof(HEAP_HEADER) + (((P_HEAP_HEADER)(ph))->hshsiz * sizeof(P_HEAP_HEADER)))
-#define ALIGN          (sizeof(size_t) * CHAR_BIT / 4)
-#define MASK           (ALIGN - 1)
-#define ASIZE(size)    (((size) & MASK) ? ((size) + ALIGN) & ~(size_t)MASK: (size))
-#define HEAD_NOTE(pfc) (*(size_t *)((PUCHAR)(pfc) - sizeof(size_t)))
-#define FOOT_NOTE(pfc) (*(size_t *)((PUCHAR)(pfc) + (HEAD_NOTE(pfc) & ~(size_t)MASK)))
-#define FREE_MASK      ( (size_t)FREE)
-#define USED_MASK      (~(size_t)USED - 1)
-
-/* File level function declarations. */
-static size_t         _nmCLZ             (size_t n);
-static P_FREE_CHUNK * _nmLocateHashTable (P_HEAP_HEADER ph, size_t i);
-static void           _nmUnlinkChunk     (P_HEAP_HEADER ph, P_FREE_CHUNK ptr);
-static void           _nmRestoreEntrance (P_FREE_CHUNK * ppfc, P_FREE_CHUNK pfc);
-static void *         _nmSplitChunk      (P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size);
-static void           _nmPutChunk        (P_HEAP_HEADER ph, P_FREE_CHUNK pfc);
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmCLZ
- * Description:   Count leading zero for size_t integer.
- * Parameter:
- *         n The integer you wan to count.
- * Return value:  Integer of leading zeros.
- */
-static size_t _nmCLZ(size_t n)
-{
-#ifdef __GNUC__
-	if (sizeof(size_t) == sizeof(long))
-		return __builtin_clzl(n);
-	else if (sizeof(size_t) == sizeof(long long))
-		return __builtin_clzll(n);
-	else
-		return __builtin_clz(n);
-#elif defined _MSC_VER
-	switch (sizeof(size_t) * CHAR_BIT)
-	{
-	case 16:
-		return __lzcnt16((short)n);
-	case 32:
-		return __lzcnt(n);
-#ifdef _M_X64
-	case 64:
-		return __lzcnt64(n);
-#endif
-	}
-#endif
-	register size_t i = n, j = 0;
-	while (i)
-	{
-		i >>= 1;
-		++j;
-	}
-	return sizeof(size_t) * CHAR_BIT - j;
-}
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmLocateHashTable
- * Description:   Locate into hash table by given index.
- * Parameters:
- *         ph Pointer to heap header.
- *          i Index.
- * Return value:  Pointer to hash table content.
- */
-static P_FREE_CHUNK * _nmLocateHashTable(P_HEAP_HEADER ph, size_t i)
-{
-	if (ph->hshsiz > i) /* Locate into hash table directly. */
-		return &i[(P_FREE_CHUNK *)((PUCHAR)ph + sizeof(HEAP_HEADER))];
-	else /* Locate to biggest one. */
-		return &(ph->hshsiz - 1)[(P_FREE_CHUNK *)((PUCHAR)ph + sizeof(HEAP_HEADER))];
-}
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmUnlinkChunk
- * Description:   Cut chunk off from linked list.
- * Parameters:
- *         ph Pointer to heap header.
- *        ptr Pointer to a free chunk.
- * Return value:  N/A.
- */
-static void _nmUnlinkChunk(P_HEAP_HEADER ph, P_FREE_CHUNK ptr)
-{
-	register P_FREE_CHUNK pfc = ptr, pofc = pfc;
-	register P_FREE_CHUNK * ppfc;
-
-	if ((_nmCLZ(HEAD_NOTE(pfc) & ~(size_t)MASK)) - _nmCLZ(ph->size) <= ph->hshsiz)
-	{
-		ppfc = _nmLocateHashTable(ph, _nmCLZ(HEAD_NOTE(pfc)) - _nmCLZ(ph->size));
-
-		if (NULL != *ppfc)
-		{
-			pfc = *ppfc;
-			do
-			{
-				pfc = pfc->p[FCP_PREV];
-				if (ptr == pfc)
-				{
-					register size_t i;
-
-					pfc->p[FCP_PREV]->p[FCP_NEXT] = pfc->p[FCP_NEXT];
-					pfc->p[FCP_NEXT]->p[FCP_PREV] = pfc->p[FCP_PREV];
-
-					i = _nmCLZ(HEAD_NOTE(pfc)) - _nmCLZ(ph->size);
-					if (pfc == *_nmLocateHashTable(ph, i)) /* Reach at linked list header. */
-						*_nmLocateHashTable(ph, i) = NULL;
-
-					break;
-				}
-			} while (pfc != pofc);
-		}
-	}
-}
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmRestoreEntrance
- * Description:   Restore hash table entrance.
- * Parameters:
- *       ppfc Pointer to hash table entrance.
- *        pfc Pointer to a free chunk.
- * Return value:  N/A.
- */
-static void _nmRestoreEntrance(P_FREE_CHUNK * ppfc, P_FREE_CHUNK pfc)
-{
-	pfc->p[FCP_PREV] = pfc->p[FCP_NEXT] = pfc;
-	if (NULL != *ppfc)
-	{
-		pfc->p[FCP_NEXT] = *ppfc;
-		(*ppfc)->p[FCP_PREV]->p[FCP_NEXT] = pfc;
-		pfc->p[FCP_PREV] = (*ppfc)->p[FCP_PREV]->p[FCP_PREV];
-		(*ppfc)->p[FCP_PREV]->p[FCP_PREV] = pfc;
-	}
-	*ppfc = pfc;
-}
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmSplitChunk
- * Description:   Split one chunk to two chunks and put back the latter one.
- * Parameters:
- *         ph Pointer to heap header.
- *        pfc Pointer to a chunk to be split.
- *       size Size of the former chunk.
- * Return value:  The same chunk which is the same to pfc.
- */
-static void * _nmSplitChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size)
-{
-	register void * pt;
-	register size_t i;
-
-	i = HEAD_NOTE(pfc) - size - sizeof(size_t);
-	i &= ~(size_t)MASK;
-	HEAD_NOTE(pfc) = size;
-	FOOT_NOTE(pfc) = size;
-	pt = pfc;
-	pfc = (P_FREE_CHUNK)((PUCHAR)pfc + size + sizeof(size_t) * 2);
-	HEAD_NOTE(pfc) = i;
-	FOOT_NOTE(pfc) = i;
-	HEAD_NOTE(pfc) |= FREE_MASK;
-	FOOT_NOTE(pfc) |= FREE_MASK;
-
-	/* Search hash table and put new free chunk to the linked list. */
-	_nmRestoreEntrance(_nmLocateHashTable(ph, _nmCLZ(i) - _nmCLZ(ph->size)), pfc);
-
-	return pt;
-}
-
-/* Attention:     This Is An Internal Function. No Interface for Library Users.
- * Function name: _nmPutChunk
- * Description:   Put free chunk back to linked list.
- * Parameters:
- *         ph Pointer to heap header.
- *        pfc Pointer to a free chunk.
- * Return value:  N/A.
- */
-static void _nmPutChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc)
-{
-	if ((_nmCLZ(HEAD_NOTE(pfc) & ~(size_t)MASK)) - _nmCLZ(ph->size) > ph->hshsiz)
-	{
-		HEAD_NOTE(pfc) |= FREE_MASK;
-		FOOT_NOTE(pfc) |= FREE_MASK;
-	}
-	else
-		_nmRestoreEntrance(_nmLocateHashTable(ph, _nmCLZ(HEAD_NOTE(pfc)) - _nmCLZ(ph->size)), pfc);
-}
-
-/* Function name: nmCreateHeap
- * Description:   Create a heap from a memory buffer.
- * Parameters:
- *      pbase Memory buffer starting address.
- *       size Size of the whole buffer.(Unit in byte)
- *     hshsiz Count of hash table entrances.
- * Return value:  NULL: Failed.
- *                Pointer to heap header(same as pbase): Succeeded.
- * Tip:           Parameter size must be greater than or equal to (sizeof(HEAP_HEADER) + (hshsiz * sizeof(P_FREE_CHUNK)) + MIN_CHUNK_SIZE).
- */
-P_HEAP_HEADER nmCreateHeap(void * pbase, size_t size, size_t hshsiz)
-{
-	P_FREE_CHUNK pfc;
-	HEAP_HEADER hh;
-	FREE_CHUNK fc;
-	size_t t;
-
-	if (NULL == pbase)
-		return NULL;
-
-	if (0 == hshsiz)
-		return NULL;
-
-	if (size < sizeof(HEAP_HEADER) + (hshsiz * sizeof(P_FREE_CHUNK)) + MIN_CHUNK_SIZE)
-		return NULL;
-
-	hh.size = size - (sizeof(HEAP_HEADER) + (hshsiz * sizeof(P_FREE_CHUNK)));
-	hh.size &= ~(size_t)MASK;
-	hh.hshsiz = hshsiz;
-
-	/* Set heap header. */
-	memcpy(pbase, &hh, sizeof(HEAP_HEADER));
-
-	/* Clear hash table. */
-	memset((PUCHAR)pbase + sizeof(HEAP_HEADER), 0, hshsiz * sizeof(size_t));
-
-	/* Set one free chunk. */
-	t = hh.size - (2 * sizeof(size_t));
-	if (t > ASIZE(t))
-		t = ASIZE(t);
-	else
-		t = t & ~(size_t)MASK;
-
-	pfc = (P_FREE_CHUNK)((PUCHAR)pbase + HEAP_BEGIN(&hh) + sizeof(size_t));
-	HEAD_NOTE(pfc) = t;
-	FOOT_NOTE(pfc) = t;
-	HEAD_NOTE(pfc) |= FREE_MASK;
-	FOOT_NOTE(pfc) |= FREE_MASK;
-
-	/* Set free chunk structure. */
-	fc.p[FCP_PREV] = fc.p[FCP_NEXT] = pfc;
-	memcpy(pfc, &fc, sizeof(FREE_CHUNK));
-
-	/* Set hash table. */
-	*_nmLocateHashTable((P_HEAP_HEADER)pbase, _nmCLZ(t) - _nmCLZ(hh.size)) = pfc;
-
-	return (P_HEAP_HEADER)pbase;
-}
-
-/* Function name: nmExtendHeap
- * Description:   Enlarge heap.
- * Parameters:
- *         ph Pointer to heap header.
- *    sizincl The incremental you want to extend.(Unit in byte)
- * Return value:  NULL: Failed.
- *                Pointer to heap header(same as ph): Succeeded.
- * Tip:           Parameter sizincl must be greater than or equal to (MIN_CHUNK_SIZE).
- */
-P_HEAP_HEADER nmExtendHeap(P_HEAP_HEADER ph, size_t sizincl)
-{
-	if (sizincl < MIN_CHUNK_SIZE)
-		return NULL;
-	else
-	{
-		/* Get the last chunk. */
-		bool bused;
-		size_t i;
-		PUCHAR phead;
-		P_FREE_CHUNK pfc;
-
-		phead = (PUCHAR)ph + HEAP_BEGIN(ph);
-		phead += ph->size - sizeof(size_t);
-
-		i = *(size_t *)phead;
-		bused = !!(i & (size_t)MASK);
-
-		if (FREE != bused)
-		{
-			pfc = (P_FREE_CHUNK)(phead + sizeof(size_t) * 2);
-
-			sizincl &= ~(size_t)MASK;
-			ph->size += sizincl;
-			sizincl -= sizeof(size_t) * 2;
-
-			HEAD_NOTE(pfc) = sizincl;
-			FOOT_NOTE(pfc) = sizincl;
-			HEAD_NOTE(pfc) |= FREE_MASK;
-			FOOT_NOTE(pfc) |= FREE_MASK;
-
-			_nmPutChunk(ph, pfc);
-		}
-		else
-		{
-			phead -= (i & ~(size_t)MASK);
-			pfc = (P_FREE_CHUNK)phead;
-
-			sizincl += i;
-			sizincl &= ~(size_t)MASK;
-
-			_nmUnlinkChunk(ph, pfc);
-			
-			ph->size = sizincl;
-
-			HEAD_NOTE(pfc) = sizincl;
-			FOOT_NOTE(pfc) = sizincl;
-			HEAD_NOTE(pfc) |= FREE_MASK;
-			FOOT_NOTE(pfc) |= FREE_MASK;
-
-			_nmPutChunk(ph, pfc);
-		}
-
-		return ph;
-	}
-}
-
-/* Function name: nmAllocHeap
- * Description:   Heap allocation.
- * Parameters:
- *         ph Pointer to heap header.
- *       size Size in bytes you want to allocate.
- * Return value:  NULL: Failed.
- *                Pointer to a heap address: Succeeded.
- */
-void * nmAllocHeap(P_HEAP_HEADER ph, size_t size)
-{
-	register size_t i, j, k;
-	register P_FREE_CHUNK pfc, * ppfc;
-	
-	if (0 == size)
-		size = ALIGN;
-
-	size = ASIZE(size);
-	j = _nmCLZ(size) - _nmCLZ(ph->size);
-
-	/* Definitely cannot allocate. */
-	if (j > _nmCLZ(size))
-		return NULL;
-
-	/* Search hash table. */
-	ppfc = _nmLocateHashTable(ph, j);
-	pfc = *ppfc;
-
-	k = ppfc - (P_FREE_CHUNK *)((PUCHAR)ph + sizeof(HEAP_HEADER));
-
-	for (i = 0; i < k; ++i)
-	{
-		if (NULL != pfc)
-			break;
-		--ppfc;
-		pfc = *ppfc;
-	}
-	
-	/* Search for fit chunk. */
-	if (NULL != pfc)
-	{
-		register P_FREE_CHUNK pofc = pfc;
-		do
-		{
-			if (size > (HEAD_NOTE(pfc) & ~(size_t)MASK))
-				pfc = pfc->p[FCP_NEXT];
-			else
-				break;
-		} while (pfc != pofc);
-	}
-	else
-		return NULL; /* No available space. */
-
-	if (size > (HEAD_NOTE(pfc) & ~(size_t)MASK))
-		return NULL; /* Cannot find a suitable chunk. */
-	else /* Cut one chunk. */
-	{
-		if (size == (HEAD_NOTE(pfc) & ~(size_t)MASK) || size > (HEAD_NOTE(pfc) & ~(size_t)MASK) - MIN_CHUNK_SIZE)
-		{	/* No need to split. */
-			_nmUnlinkChunk(ph, pfc);
-
-			/* Set used. */
-			HEAD_NOTE(pfc) &= USED_MASK;
-			FOOT_NOTE(pfc) &= USED_MASK;
-
-			return pfc;
-		}
-		else
-		{
-			_nmUnlinkChunk(ph, pfc);
-			return _nmSplitChunk(ph, pfc, size); /* Split. */
-		}
-	}
-}
-
-/* Function name: nmFreeHeap
- * Description:   Heap freedom.
- * Parameters:
- *         ph Pointer to heap header.
- *        ptr Pointer in heap that you want to free.
- * Return value:  N/A.
- */
-void nmFreeHeap(P_HEAP_HEADER ph, void * ptr)
-{
-	register P_FREE_CHUNK pfc = (P_FREE_CHUNK)ptr;
-	register bool bbtm = FREE, bhed = FREE;
-	register size_t upcolsiz, upcolcnt;
-	register size_t lwcolsiz, lwcolcnt;
-	register size_t chksiz;
-	register size_t i;
-	
-	if (NULL == ptr)
-		return;
-
-	/* Get upper bound. */
-	if ((PUCHAR)pfc - sizeof(size_t) <= (PUCHAR)ph + HEAP_BEGIN(ph))
-		bhed = USED;
-
-	upcolsiz = 0;
-	upcolcnt = 0;
-
-	do
-	{
-		if (FREE == bhed)
-		{
-			register size_t t = *(size_t *)((PUCHAR)pfc - 2 * sizeof(size_t));
-			chksiz = (t & ~(size_t)MASK);
-			if (FREE == !!(t & (size_t)MASK))
-			{
-				pfc = (P_FREE_CHUNK)((PUCHAR)pfc - 2 * sizeof(size_t) - chksiz);
-				upcolsiz += chksiz;
-				++upcolcnt;
-
-				/* Unlink chunk. */
-				_nmUnlinkChunk(ph, pfc);
-			}
-			else
-				break;
-		}
-		else
-			break;
-
-		if ((PUCHAR)pfc - sizeof(size_t) <= (PUCHAR)ph + HEAP_BEGIN(ph))
-			bhed = USED;
-	} while (USED != bhed);
-
-	pfc = (P_FREE_CHUNK)ptr;
-
-	/* Get lower bound. */
-	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-
-	if (ASIZE((PUCHAR)pfc + chksiz + sizeof(size_t) - ((PUCHAR)ph + HEAP_BEGIN(ph))) >= ph->size)
-		bbtm = USED;
-
-	lwcolsiz = 0;
-	lwcolcnt = 0;
-
-	while (FREE == bbtm && FREE == !!(*(size_t *)((PUCHAR)pfc + chksiz + sizeof(size_t)) & (size_t)MASK))
-	{
-		pfc = (P_FREE_CHUNK)((PUCHAR)pfc + chksiz + 2 * sizeof(size_t));
-		chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-		lwcolsiz += chksiz;
-		++lwcolcnt;
-
-		/* Unlink chunk. */
-		_nmUnlinkChunk(ph, pfc);
-
-		if (ASIZE((PUCHAR)pfc + chksiz + sizeof(size_t) - ((PUCHAR)ph + HEAP_BEGIN(ph))) >= ph->size)
-			bbtm = USED;
-	}
-
-	/* Coalesce up and downward. */
-	pfc = (P_FREE_CHUNK)ptr;
-
-	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-
-	i = upcolsiz + sizeof(size_t) * 2 * upcolcnt;
-
-	if (upcolcnt)
-		pfc = (P_FREE_CHUNK)((PUCHAR)pfc - i);
-
-	chksiz += i;
-
-	chksiz += lwcolsiz + sizeof(size_t) * 2 * lwcolcnt;
-
-	HEAD_NOTE(pfc) = chksiz;
-	FOOT_NOTE(pfc) = chksiz;
-	HEAD_NOTE(pfc) |= FREE_MASK;
-	FOOT_NOTE(pfc) |= FREE_MASK;
-
-	/* Put free chunk back into hash table or leave it alone. */
-	_nmPutChunk(ph, pfc);
-}
-
-/* Function name: nmReallocHeap
- * Description:   Heap reallocation.
- * Parameters:
- *         ph Pointer to heap header.
- *        ptr Pointer in heap that you want to reallocate.
- *       size New size of memory chunk.
- * Return value:  NULL: Reallocation failed.
- *                Pointer to heap memory: Succeeded.
- * Tip:           The return value can either be ptr or a new address or NULL.
- */
-void * nmReallocHeap(P_HEAP_HEADER ph, void * ptr, size_t size)
-{
-	register size_t i;
-	register size_t chksiz;
-	register size_t lwcolsiz, lwcolcnt;
-	register bool bbtm = FREE;
-
-	if (NULL == ptr)
-		return nmAllocHeap(ph, size);
-	else if (0 == size)
-	{
-		nmFreeHeap(ph, ptr);
-		return NULL;
-	}
-
-	size = ASIZE(size);
-	i = _nmCLZ(size) - _nmCLZ(ph->size);
-
-	/* Definitely cannot allocate. */
-	if (i > _nmCLZ(size))
-		return NULL;
-
-	if (size < HEAD_NOTE((P_FREE_CHUNK)ptr))
-		return _nmSplitChunk(ph, (P_FREE_CHUNK)ptr, size); /* Split. */
-	else if (size == HEAD_NOTE((P_FREE_CHUNK)ptr))
-		return ptr;
-	else /* Try to collect residues. */
-	{
-		register P_FREE_CHUNK pfc;
-
-		pfc = (P_FREE_CHUNK)ptr;
-
-		/* Get lower bound. */
-		chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-
-		if (ASIZE((PUCHAR)pfc + chksiz + sizeof(size_t) - ((PUCHAR)ph + HEAP_BEGIN(ph))) >= ph->size)
-			bbtm = USED;
-
-		lwcolsiz = 0;
-		lwcolcnt = 0;
-
-		while (FREE == bbtm && FREE == !!(*(size_t *)((PUCHAR)pfc + chksiz + sizeof(size_t)) & (size_t)MASK))
-		{
-			pfc = (P_FREE_CHUNK)((PUCHAR)pfc + chksiz + 2 * sizeof(size_t));
-			chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-			lwcolsiz += chksiz;
-			++lwcolcnt;
-
-			/* Unlink chunk. */
-			_nmUnlinkChunk(ph, pfc);
-
-			if (ASIZE((PUCHAR)pfc + chksiz + sizeof(size_t) - ((PUCHAR)ph + HEAP_BEGIN(ph))) >= ph->size)
-				bbtm = USED;
-		}
-
-		/* Coalesce downward. */
-		pfc = (P_FREE_CHUNK)ptr;
-
-		chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
-
-		chksiz += lwcolsiz + sizeof(size_t) * 2 * lwcolcnt;
-
-		HEAD_NOTE(pfc) = chksiz;
-		FOOT_NOTE(pfc) = chksiz;
-
-		if (chksiz >= size)
-		{
-			HEAD_NOTE(pfc) &= USED_MASK;
-			FOOT_NOTE(pfc) &= USED_MASK;
-
-			if (chksiz - size < MIN_CHUNK_SIZE)
-				return pfc;
-
-			return _nmSplitChunk(ph, (P_FREE_CHUNK)pfc, size); /* Split. */
-		}
-		else
-		{
-			register void * pr;
-			pr = nmAllocHeap(ph, size);
-			if (NULL != pr)
-			{
-				memcpy(pr, pfc, sizeof(HEAD_NOTE(pfc)));
-				_nmPutChunk(ph, pfc);
-			}
-			return pr;
-		}
-	}
-}
-
+/*
+ * Name:        neomalloc.c
+ * Description: Neo malloc core function.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1207250701A1610260122L02695
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "neomalloc.h"
+#include <limits.h>  /* Using macro CHAR_BIT. */
+#include <stdint.h>  /* Using type uint32_t. */
+#include <string.h>  /* Using function memcpy, memmove, memset. */
+
+#ifdef _MSC_VER
+#include <intrin.h>  /* Use function __lzcnt16, __lzcnt and __lzcnt64. */
+#endif
+
+/* [HEAP MEMORY DIAGRAM]
+ * +=HEAP_HEADER=+
+ * |size         *===>sizeof(chunk) == head note + free chunk + data + foot note.
+ * |-------------|
+ * |hshsiz:3     |
+ * +=============+
+ * |   POINTER   *-->NULL      Small chunks.
+ * |-------------|
+ * |   POINTER   *-->NULL
+ * |-------------|
+ * |   POINTER   *>-------\    Big chunks.
+ * +=============+        |
+ * |   BITMAP    |001     |    Bit i is set while entrance i is not NULL.
+ * |-------------|        |
+ * |   SUMMARY   |1       |    Bit w is set while bitmap word w is not 0.
+ * +=============+--------|--------\
+ * |Head_note    |        V        |
+ * +=FREE_CHUNK==+<-------/<--\    |
+ * | p[FCP_PREV] *>-----------/    |
+ * |-------------|            ^    |
+ * | p[FCP_NEXT] *>-----------/    > This is a free chunk.
+ * +=============+                 |
+ * |    DATA     *==sizeof(size_t) |
+ * |             |  *4             |
+ * |             |                 |
+ * |             |                 |
+ * +=============+        /--------/
+ * |Foot_note    |        |
+ * +=============+--------/
+ * Under NM_OFFSETS every POINTER and p[] holds the offset of a chunk from HEAP_HEADER instead, 0 for NULL.
+ * Under NM_COMPACT those offsets, head notes and foot notes take 32 bits each, and ALIGN is 8.
+ */
+
+/* [SEGMENT DIAGRAM] Only for heaps created with HF_GROW.
+ * +=HEAP_GROWER=+                After SUMMARY.
+ * | cbf         |
+ * | pparam      |
+ * | cbp         |
+ * | page        |
+ * | thresh      |
+ * | dirty       |
+ * | cbm         |
+ * | mapgran     |
+ * | mapmin      |
+ * | pseg        *-->+=HEAP_SEGMENT=+
+ * +=============+   | pnext        *-->Next segment or NULL.
+ *                   | size         |
+ *                   +==============+
+ *                   | 0            |   Sentinel that reads as a used foot note.
+ *                   +--------------+
+ *                   | Chunks       |   size bytes.
+ *                   +--------------+
+ *                   | 0            |   Sentinel that reads as a used head note.
+ *                   +==============+
+ *
+ * [MAPPED BLOCK DIAGRAM] A huge block of a HF_GROW heap that has a mapper.
+ * +=============+<--- Start of the mapping.
+ * | Map size    |     Bytes of the mapping.
+ * |-------------|
+ * | Head note   |     Usable size | MAP_MASK. FREE_MASK is clear. It is the last TAG before DATA.
+ * +=============+
+ * |    DATA     |
+ * +=============+
+ */
+
+/* [QUICK LIST DIAGRAM] Only for heaps created with HF_QUICK.
+ * +=HEAP_QUICK==+                After HEAP_GROWER, or after SUMMARY without HF_GROW.
+ * | bin[0]      *-->+=Used chunk===+
+ * |-------------|   | p[FCP_NEXT]  *-->Next chunk of ALIGN bytes or NULL.
+ * |    ...      |   +==============+   Tags keep FREE_MASK clear and carry QUICK_MASK.
+ * | bin[7]      *-->Chunks of 8 * ALIGN bytes.
+ * | count       |
+ * | limit       |
+ * +=============+
+ */
+
+/* [TREE DIAGRAM] Only for heaps created with HF_BEST. The last entrance holds the root.
+ * +=TREE_CHUNK==+
+ * | p[FCP_PREV] *>--\        Both point at the chunk itself, so it never looks pending.
+ * |-------------|   |
+ * | p[FCP_NEXT] *>--/
+ * |-------------|
+ * | t[TCP_LEFT] *-->Smaller chunk or NULL.
+ * |-------------|
+ * | t[TCP_RIGHT]*-->Bigger chunk or NULL.
+ * |-------------|
+ * |t[TCP_PARENT]*-->NULL for the root.
+ * |-------------|
+ * | red         *-->The chunk itself when red, NULL when black.
+ * +=============+
+ * Chunks are ordered by size, then by address, so no two keys are equal.
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+typedef unsigned char   UCHART;
+
+/* Chunk pointer indices. */
+enum en_FreeChunkPointer
+{
+	FCP_PREV = 0,
+	FCP_NEXT = 1,
+	FCP_MAX  = 2
+};
+
+/* Tree node indices of a chunk in the last entrance of a HF_BEST heap. */
+enum en_TreeChunkPointer
+{
+	TCP_LEFT   = 0,
+	TCP_RIGHT  = 1,
+	TCP_PARENT = 2,
+	TCP_MAX    = 3
+};
+
+/* Used and unused mark. */
+#define USED false
+#define FREE true
+
+/* Link to a free chunk. Under NM_OFFSETS it is the offset of the chunk from the heap header, 0 for none. */
+#if defined(NM_COMPACT)
+typedef uint32_t              LINK;
+#elif defined(NM_OFFSETS)
+typedef size_t                LINK;
+#else
+typedef struct st_FreeChunk * LINK;
+#endif
+
+/* Boundary tag: head note or foot note. */
+#ifdef NM_COMPACT
+typedef uint32_t              TAG;
+#else
+typedef size_t                TAG;
+#endif
+
+/* Free chunk linked list node. */
+typedef struct st_FreeChunk
+{
+	LINK p[FCP_MAX];
+} FREE_CHUNK, * P_FREE_CHUNK;
+
+/* Free chunk in the red-black tree of a HF_BEST heap. */
+typedef struct st_TreeChunk
+{
+	FREE_CHUNK fc;         /* Both links point to the chunk itself. */
+	LINK       t[TCP_MAX];
+	LINK       red;        /* Link to the chunk itself when red, 0 when black. */
+} TREE_CHUNK, * P_TREE_CHUNK;
+
+/* Extra segment of a HF_GROW heap. Its chunks follow it between two sentinel tags. */
+typedef struct st_HeapSegment
+{
+	struct st_HeapSegment * pnext; /* Next segment in the order they were added. */
+	size_t                  size;  /* Bytes of chunks, like ph->size. */
+} HEAP_SEGMENT, * P_HEAP_SEGMENT;
+
+/* Region provider of a HF_GROW heap. It lies between the bitmap summary and the chunks. */
+typedef struct st_HeapGrower
+{
+	CBF_REGION     cbf;
+	void *         pparam;
+	CBF_PURGE      cbp;    /* Page purger. */
+	size_t         page;   /* Page size of the purger. */
+	size_t         thresh; /* Free chunks at least this big are purged lazily. 0 for never. */
+	size_t         dirty;  /* Bytes freed into such chunks since the last purge. */
+	CBF_REMAP      cbm;    /* Mapper of huge blocks. */
+	size_t         mapgran;/* Mappings are multiples of this. */
+	size_t         mapmin; /* Blocks at least this big are mapped on their own. */
+	P_HEAP_SEGMENT pseg;   /* The first extra segment. */
+} HEAP_GROWER, * P_HEAP_GROWER;
+
+/* Quick lists of a HF_QUICK heap. Each one holds freed chunks of a single size. */
+#define QUICK_BINS 8
+typedef struct st_HeapQuick
+{
+	LINK   bin[QUICK_BINS]; /* bin[i] holds used chunks of (i + 1) * ALIGN bytes, linked by p[FCP_NEXT]. */
+	size_t count;           /* Chunks in all quick lists. */
+	size_t limit;           /* The lists are flushed into the bins when count reaches it. 0 for off. */
+} HEAP_QUICK, * P_HEAP_QUICK;
+
+/* Usable macros. */
+#define MIN_CHUNK_SIZE (sizeof(TAG) * 2 + sizeof(FREE_CHUNK))
+#define BMP_BITS       (sizeof(size_t) * CHAR_BIT)
+#define BMP_SIZE(n)    (((n) + BMP_BITS - 1) / BMP_BITS)
+#define HASH_TABLE(ph) ((LINK *)((PUCHAR)(ph) + sizeof(HEAP_HEADER)))
+#define LINK_SIZE(n)   (((n) * sizeof(LINK) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1)) /* Keeps the bitmap aligned. */
+#define BIN_BITMAP(ph) ((size_t *)((PUCHAR)HASH_TABLE(ph) + LINK_SIZE(((P_HEAP_HEADER)(ph))->hshsiz)))
+#define BIN_SUMMARY(ph) (BIN_BITMAP(ph)[BMP_SIZE(((P_HEAP_HEADER)(ph))->hshsiz)])
+#define TABLE_SIZE(n)  (LINK_SIZE(n) + (BMP_SIZE(n) + 1) * sizeof(size_t))
+#define HEAP_GROWER(ph) ((P_HEAP_GROWER)(&BIN_SUMMARY(ph) + 1))
+#define FIRST_SEGMENT(ph) ((HF_GROW & ((P_HEAP_HEADER)(ph))->flags) ? HEAP_GROWER(ph)->pseg : NULL)
+#define SEG_BEGIN(ps)  ((PUCHAR)(ps) + sizeof(HEAP_SEGMENT) + sizeof(TAG)) /* The first head note. */
+#define SEG_OVERHEAD   (sizeof(HEAP_SEGMENT) + 2 * sizeof(TAG))
+#define HEAP_QUICK(ph)  ((P_HEAP_QUICK)((PUCHAR)(&BIN_SUMMARY(ph) + 1) + \
+                         ((((P_HEAP_HEADER)(ph))->flags & HF_GROW) ? sizeof(HEAP_GROWER) : 0)))
+#define HEAP_BEGIN(ph) (sizeof(HEAP_HEADER) + TABLE_SIZE(((P_HEAP_HEADER)(ph))->hshsiz) + \
+                        ((((P_HEAP_HEADER)(ph))->flags & HF_GROW) ? sizeof(HEAP_GROWER) : 0) + \
+                        ((((P_HEAP_HEADER)(ph))->flags & HF_QUICK) ? sizeof(HEAP_QUICK) : 0) + \
+                        ((((P_HEAP_HEADER)(ph))->flags & HF_PADDED) ? sizeof(TAG) : 0))
+#define ALIGN          NM_ALIGN
+#define MASK           (ALIGN - 1)
+#define ASIZE(size)    (((size) & MASK) ? ((size) + ALIGN) & ~(size_t)MASK: (size))
+#define HEAD_NOTE(pfc) (*(TAG *)((PUCHAR)(pfc) - sizeof(TAG)))
+#define FOOT_NOTE(pfc) (*(TAG *)((PUCHAR)(pfc) + (HEAD_NOTE(pfc) & ~(size_t)MASK)))
+#define FREE_MASK      ( (size_t)FREE)
+#define USED_MASK      (~(size_t)USED - 1)
+#define ZERO_MASK      ((size_t)2) /* Free chunk whose payload is zero except for its links. */
+#define PURGE_MASK     ((size_t)4) /* Free chunk whose inner pages were given to the purger. */
+#define MAP_MASK       ZERO_MASK   /* Used chunk that is mapped on its own. */
+#define QUICK_MASK     PURGE_MASK  /* Used chunk held by a quick list. Used chunks have no other bit. */
+#define QUICKED(h)     (((h) & (FREE_MASK | QUICK_MASK)) == QUICK_MASK)
+#define QUICK_MAX      (QUICK_BINS * ALIGN) /* The biggest chunk that quick lists hold. */
+#define QUICK_LIMIT    64          /* Chunks held by quick lists until nmSetHeapQuick says otherwise. */
+#define MAPPED(pfc)    ((HEAD_NOTE(pfc) & (FREE_MASK | MAP_MASK)) == MAP_MASK)
+#define PURGE_LAZY     4           /* Purge once this many thresholds were freed into big chunks. */
+#define SLI(ph)        (((P_HEAP_HEADER)(ph))->flags & HF_SLI_MASK)
+/* Only the edges of the heap itself are tested. Chunks of other segments meet sentinels that look used. */
+#define HAS_PREV(ph, pfc)    ((PUCHAR)(pfc) - sizeof(TAG) != (PUCHAR)(ph) + HEAP_BEGIN(ph))
+#define HAS_NEXT(ph, pfc, n) ((PUCHAR)(pfc) + (n) + sizeof(TAG) != (PUCHAR)(ph) + HEAP_BEGIN(ph) + (ph)->size)
+#ifdef NM_STATS
+#define STAT(ph, field, n)   ((ph)->cnt.field += (size_t)(n))
+#else
+#define STAT(ph, field, n)   ((void)0)
+#endif
+#define MAX_BLOCK            ((size_t)(TAG)-1 >> 2) /* Keeps sums of a few sizes from overflowing. */
+#define CANNOT_FIT(ph, n)    ((HF_GROW & (ph)->flags) ? (n) > MAX_BLOCK : (n) > (ph)->size)
+#define PENDING(pfc)         ((HEAD_NOTE(pfc) & FREE_MASK) && (LINK)0 == (pfc)->p[FCP_PREV]) /* Marked by nmFreeBatch. */
+/* Convert between links and chunk pointers. Integer arithmetic lets segments lie below the heap header. */
+#ifdef NM_OFFSETS
+#define L2P(ph, l)           ((P_FREE_CHUNK)((l) ? (size_t)(ph) + (l) : 0))
+#define P2L(ph, pfc)         ((LINK)((pfc) ? (size_t)(pfc) - (size_t)(ph) : 0))
+#else
+#define L2P(ph, l)           (l)
+#define P2L(ph, pfc)         (pfc)
+#endif
+/* Layout flags that every heap of this build carries, and whether offsets from the heap header fit in a link. */
+#if defined(NM_COMPACT)
+#define HF_LINKS             (HF_OFFSETS | HF_COMPACT)
+#define OUT_OF_REACH(ph, p, n) ((size_t)(p) < (size_t)(ph) || (n) > (size_t)(LINK)-1 || \
+                               (size_t)(p) - (size_t)(ph) > (size_t)(LINK)-1 - (n))
+#elif defined(NM_OFFSETS)
+#define HF_LINKS             HF_OFFSETS
+#define OUT_OF_REACH(ph, p, n) false
+#else
+#define HF_LINKS             0
+#define OUT_OF_REACH(ph, p, n) false
+#endif
+#define NEXT(ph, pfc)        L2P(ph, (pfc)->p[FCP_NEXT])
+#define PREV(ph, pfc)        L2P(ph, (pfc)->p[FCP_PREV])
+/* Tree of HF_BEST heaps. */
+#define TREE(pfc)            ((P_TREE_CHUNK)(pfc))
+#define CHILD(ph, pfc, d)    L2P(ph, TREE(pfc)->t[d])
+#define PARENT(ph, pfc)      L2P(ph, TREE(pfc)->t[TCP_PARENT])
+#define RED(pfc)             (NULL != (pfc) && (LINK)0 != TREE(pfc)->red)
+#define PAINT(ph, pfc, bred) (TREE(pfc)->red = (bred) ? P2L(ph, pfc) : (LINK)0)
+#define TREE_BIN(ph, i)      ((HF_BEST & (ph)->flags) && (i) >= (ph)->hshsiz - 1)
+#define NODE_SIZE(ph)        ((HF_BEST & (ph)->flags) ? sizeof(TREE_CHUNK) : sizeof(FREE_CHUNK)) /* Bytes of a zero chunk that are not zero. */
+
+/* File level function declarations. */
+static size_t         _nmCLZ             (size_t n);
+static size_t         _nmCTZ             (size_t n);
+static size_t         _nmBinIndex        (P_HEAP_HEADER ph, size_t size);
+static LINK *         _nmLocateHashTable (P_HEAP_HEADER ph, size_t i);
+static void           _nmMarkBin         (P_HEAP_HEADER ph, size_t i, bool bset);
+static bool           _nmTreeLess        (P_FREE_CHUNK pa, P_FREE_CHUNK pb);
+static void           _nmTreeRotate      (P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK px, size_t d);
+static void           _nmTreeReplace     (P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pu, P_FREE_CHUNK pv);
+static void           _nmTreeInsert      (P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pfc);
+static void           _nmTreeRemove      (P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pfc);
+static P_FREE_CHUNK   _nmTreeFit         (P_HEAP_HEADER ph, size_t size);
+static P_FREE_CHUNK   _nmBinFirst        (P_HEAP_HEADER ph, size_t i);
+static P_FREE_CHUNK   _nmBinNext         (P_HEAP_HEADER ph, size_t i, P_FREE_CHUNK pfc);
+static void           _nmUnlinkChunk     (P_HEAP_HEADER ph, P_FREE_CHUNK ptr);
+static void           _nmRestoreEntrance (P_HEAP_HEADER ph, LINK * ppfc, P_FREE_CHUNK pfc);
+static size_t         _nmFindBinAbove    (P_HEAP_HEADER ph, size_t i);
+static P_FREE_CHUNK   _nmScanBin         (P_HEAP_HEADER ph, size_t i, size_t size);
+static P_FREE_CHUNK   _nmTakeBin         (P_HEAP_HEADER ph, size_t i, size_t size);
+static P_FREE_CHUNK   _nmFitFirst        (P_HEAP_HEADER ph, size_t size);
+static P_FREE_CHUNK   _nmFitSegregated   (P_HEAP_HEADER ph, size_t size);
+static void *         _nmSplitChunk      (P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size);
+static void *         _nmShrinkChunk     (P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size);
+static void           _nmPutChunk        (P_HEAP_HEADER ph, P_FREE_CHUNK pfc);
+static bool           _nmFlushQuick      (P_HEAP_HEADER ph);
+static void *         _nmAllocChunk      (P_HEAP_HEADER ph, size_t size, size_t * pzero);
+static void           _nmFreeChunk       (P_HEAP_HEADER ph, void * ptr);
+static bool           _nmGrowHeap        (P_HEAP_HEADER ph, size_t size);
+static size_t         _nmPurgeFree       (P_HEAP_HEADER ph, size_t minsiz, size_t keep);
+static void           _nmNoteFree        (P_HEAP_HEADER ph, size_t size);
+static void *         _nmMapChunk        (P_HEAP_HEADER ph, size_t size);
+static void *         _nmRemapChunk      (P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size);
+static bool           _nmIsChunk         (P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t bits);
+static int            _nmCheckChunk      (P_HEAP_HEADER ph, PUCHAR pend, P_FREE_CHUNK pfc, bool bprev);
+static int            _nmCheckRange      (P_HEAP_HEADER ph, size_t * pcur, size_t nchk, size_t * pnfree, size_t * pnquick);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmCLZ
+ * Description:   Count leading zero for size_t integer.
+ * Parameter:
+ *         n The integer you wan to count.
+ * Return value:  Integer of leading zeros.
+ */
+static size_t _nmCLZ(size_t n)
+{
+#ifdef __GNUC__
+	if (sizeof(size_t) == sizeof(long))
+		return __builtin_clzl(n);
+	else if (sizeof(size_t) == sizeof(long long))
+		return __builtin_clzll(n);
+	else
+		return __builtin_clz(n);
+#elif defined _MSC_VER
+	switch (sizeof(size_t) * CHAR_BIT)
+	{
+	case 16:
+		return __lzcnt16((short)n);
+	case 32:
+		return __lzcnt(n);
+#ifdef _M_X64
+	case 64:
+		return __lzcnt64(n);
+#endif
+	}
+#endif
+	register size_t i = n, j = 0;
+	while (i)
+	{
+		i >>= 1;
+		++j;
+	}
+	return sizeof(size_t) * CHAR_BIT - j;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmCTZ
+ * Description:   Count trailing zero for size_t integer.
+ * Parameter:
+ *         n The integer you wan to count. It must not be 0.
+ * Return value:  Integer of trailing zeros.
+ */
+static size_t _nmCTZ(size_t n)
+{
+#ifdef __GNUC__
+	if (sizeof(size_t) == sizeof(long))
+		return __builtin_ctzl(n);
+	else if (sizeof(size_t) == sizeof(long long))
+		return __builtin_ctzll(n);
+	else
+		return __builtin_ctz(n);
+#elif defined _MSC_VER
+	unsigned long r;
+#ifdef _M_X64
+	if (sizeof(size_t) * CHAR_BIT == 64)
+	{
+		_BitScanForward64(&r, n);
+		return r;
+	}
+#endif
+	_BitScanForward(&r, (unsigned long)n);
+	return r;
+#endif
+	register size_t i = n, j = 0;
+	while (!(i & 1))
+	{
+		i >>= 1;
+		++j;
+	}
+	return j;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmBinIndex
+ * Description:   Map a chunk size to a hash table index by its absolute size, smallest chunks first.
+ *                Each power of two class of ALIGN units is split into 2^SLI(ph) linear sub-classes.
+ *                Power of two heaps have SLI(ph) == 0, so entrance i holds sizes in [2^i, 2^(i+1)) units.
+ *                The index never depends on ph->size, so extending a heap keeps every bin valid.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Size of a chunk.
+ * Return value:  Index. It may exceed ph->hshsiz.
+ */
+static size_t _nmBinIndex(P_HEAP_HEADER ph, size_t size)
+{
+	register size_t u = size >> _nmCTZ(ALIGN), l;
+
+	l = BMP_BITS - 1 - _nmCLZ(u);
+	if (l <= SLI(ph)) /* Small chunks have one bin per ALIGN unit. */
+		return u - 1;
+
+	return ((l - SLI(ph)) << SLI(ph)) + (u >> (l - SLI(ph))) - 1;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmLocateHashTable
+ * Description:   Locate into hash table by given index.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index.
+ * Return value:  Pointer to hash table content.
+ */
+static LINK * _nmLocateHashTable(P_HEAP_HEADER ph, size_t i)
+{
+	if (ph->hshsiz > i) /* Locate into hash table directly. */
+		return &i[HASH_TABLE(ph)];
+	else /* Locate to biggest one. */
+		return &(ph->hshsiz - 1)[HASH_TABLE(ph)];
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMarkBin
+ * Description:   Set or clear the bitmap bit of a hash table entrance.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the entrance.
+ *       bset true: entrance becomes non-empty. false: entrance becomes empty.
+ * Return value:  N/A.
+ */
+static void _nmMarkBin(P_HEAP_HEADER ph, size_t i, bool bset)
+{
+	register size_t * pbmp = &BIN_BITMAP(ph)[i / BMP_BITS];
+
+	if (bset)
+	{
+		*pbmp |= (size_t)1 << (i % BMP_BITS);
+		BIN_SUMMARY(ph) |= (size_t)1 << (i / BMP_BITS);
+	}
+	else
+	{
+		*pbmp &= ~((size_t)1 << (i % BMP_BITS));
+		if (0 == *pbmp)
+			BIN_SUMMARY(ph) &= ~((size_t)1 << (i / BMP_BITS));
+	}
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeLess
+ * Description:   Order of chunks in the tree: by size, then by address.
+ * Parameters:
+ *         pa Pointer to a free chunk.
+ *         pb Pointer to another free chunk.
+ * Return value:  true if pa goes before pb.
+ */
+static bool _nmTreeLess(P_FREE_CHUNK pa, P_FREE_CHUNK pb)
+{
+	register size_t a = HEAD_NOTE(pa) & ~(size_t)MASK, b = HEAD_NOTE(pb) & ~(size_t)MASK;
+
+	return a < b || (a == b && (size_t)pa < (size_t)pb);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeRotate
+ * Description:   Rotate the tree at a chunk.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *      proot Pointer to the entrance that holds the root.
+ *         px Pointer to a chunk whose child on the other side of d is not NULL.
+ *          d TCP_LEFT: The right child takes the place of px. TCP_RIGHT: The left child does.
+ * Return value:  N/A.
+ */
+static void _nmTreeRotate(P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK px, size_t d)
+{
+	register P_FREE_CHUNK py = CHILD(ph, px, !d), pp = PARENT(ph, px);
+	register LINK lx = P2L(ph, px), ly = P2L(ph, py);
+
+	(void)ph; /* Unused when links are pointers. */
+	TREE(px)->t[!d] = TREE(py)->t[d];
+	if ((LINK)0 != TREE(py)->t[d])
+		TREE(CHILD(ph, py, d))->t[TCP_PARENT] = lx;
+	TREE(py)->t[TCP_PARENT] = TREE(px)->t[TCP_PARENT];
+	if (NULL == pp)
+		*proot = ly;
+	else
+		TREE(pp)->t[lx == TREE(pp)->t[TCP_LEFT] ? TCP_LEFT : TCP_RIGHT] = ly;
+	TREE(py)->t[d] = lx;
+	TREE(px)->t[TCP_PARENT] = ly;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeReplace
+ * Description:   Hang a subtree where a chunk was hanging.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *      proot Pointer to the entrance that holds the root.
+ *         pu Pointer to the chunk being replaced.
+ *         pv Pointer to the root of the subtree or NULL.
+ * Return value:  N/A.
+ */
+static void _nmTreeReplace(P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pu, P_FREE_CHUNK pv)
+{
+	register P_FREE_CHUNK pp = PARENT(ph, pu);
+	register LINK lu = P2L(ph, pu);
+
+	(void)ph; /* Unused when links are pointers. */
+	if (NULL == pp)
+		*proot = P2L(ph, pv);
+	else
+		TREE(pp)->t[lu == TREE(pp)->t[TCP_LEFT] ? TCP_LEFT : TCP_RIGHT] = P2L(ph, pv);
+	if (NULL != pv)
+		TREE(pv)->t[TCP_PARENT] = TREE(pu)->t[TCP_PARENT];
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeInsert
+ * Description:   Insert a chunk into the red-black tree in O(log n).
+ * Parameters:
+ *         ph Pointer to heap header.
+ *      proot Pointer to the entrance that holds the root.
+ *        pfc Pointer to a free chunk.
+ * Return value:  N/A.
+ */
+static void _nmTreeInsert(P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pfc)
+{
+	register P_FREE_CHUNK px = L2P(ph, *proot), pp = NULL, pg;
+	register LINK l = P2L(ph, pfc);
+	register size_t d = TCP_LEFT;
+
+	pfc->p[FCP_PREV] = pfc->p[FCP_NEXT] = l;
+	TREE(pfc)->t[TCP_LEFT] = TREE(pfc)->t[TCP_RIGHT] = (LINK)0;
+	PAINT(ph, pfc, true);
+
+	while (NULL != px)
+	{
+		pp = px;
+		d = _nmTreeLess(pfc, px) ? TCP_LEFT : TCP_RIGHT;
+		px = CHILD(ph, px, d);
+	}
+	TREE(pfc)->t[TCP_PARENT] = P2L(ph, pp);
+	if (NULL == pp)
+		*proot = l;
+	else
+		TREE(pp)->t[d] = l;
+
+	/* A red parent is never the root, so the grandparent exists. */
+	while (pp = PARENT(ph, pfc), RED(pp))
+	{
+		pg = PARENT(ph, pp);
+		d = pp == CHILD(ph, pg, TCP_LEFT) ? TCP_LEFT : TCP_RIGHT;
+		px = CHILD(ph, pg, !d); /* Uncle. */
+		if (RED(px))
+		{
+			PAINT(ph, pp, false);
+			PAINT(ph, px, false);
+			PAINT(ph, pg, true);
+			pfc = pg;
+		}
+		else
+		{
+			if (pfc == CHILD(ph, pp, !d))
+			{
+				pfc = pp;
+				_nmTreeRotate(ph, proot, pfc, d);
+				pp = PARENT(ph, pfc);
+			}
+			PAINT(ph, pp, false);
+			PAINT(ph, pg, true);
+			_nmTreeRotate(ph, proot, pg, !d);
+		}
+	}
+	PAINT(ph, L2P(ph, *proot), false);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeRemove
+ * Description:   Remove a chunk from the red-black tree in O(log n).
+ * Parameters:
+ *         ph Pointer to heap header.
+ *      proot Pointer to the entrance that holds the root.
+ *        pfc Pointer to a free chunk in the tree.
+ * Return value:  N/A.
+ */
+static void _nmTreeRemove(P_HEAP_HEADER ph, LINK * proot, P_FREE_CHUNK pfc)
+{
+	register P_FREE_CHUNK px, pp, py = pfc, pw;
+	register bool bred = RED(pfc);
+	register size_t d;
+
+	if (NULL == CHILD(ph, pfc, TCP_LEFT) || NULL == CHILD(ph, pfc, TCP_RIGHT))
+	{
+		px = CHILD(ph, pfc, NULL == CHILD(ph, pfc, TCP_LEFT) ? TCP_RIGHT : TCP_LEFT);
+		pp = PARENT(ph, pfc);
+		_nmTreeReplace(ph, proot, pfc, px);
+	}
+	else
+	{	/* The successor takes the place of pfc. */
+		for (py = CHILD(ph, pfc, TCP_RIGHT); NULL != CHILD(ph, py, TCP_LEFT); py = CHILD(ph, py, TCP_LEFT))
+			;
+		bred = RED(py);
+		px = CHILD(ph, py, TCP_RIGHT);
+		if (pfc == PARENT(ph, py))
+			pp = py;
+		else
+		{
+			pp = PARENT(ph, py);
+			_nmTreeReplace(ph, proot, py, px);
+			TREE(py)->t[TCP_RIGHT] = TREE(pfc)->t[TCP_RIGHT];
+			TREE(CHILD(ph, py, TCP_RIGHT))->t[TCP_PARENT] = P2L(ph, py);
+		}
+		_nmTreeReplace(ph, proot, pfc, py);
+		TREE(py)->t[TCP_LEFT] = TREE(pfc)->t[TCP_LEFT];
+		TREE(CHILD(ph, py, TCP_LEFT))->t[TCP_PARENT] = P2L(ph, py);
+		PAINT(ph, py, RED(pfc));
+	}
+	if (bred)
+		return;
+
+	/* px carries an extra black. Its sibling is not NULL, or black heights would differ. */
+	while (NULL != pp && !RED(px))
+	{
+		d = px == CHILD(ph, pp, TCP_LEFT) ? TCP_LEFT : TCP_RIGHT;
+		pw = CHILD(ph, pp, !d);
+		if (RED(pw))
+		{
+			PAINT(ph, pw, false);
+			PAINT(ph, pp, true);
+			_nmTreeRotate(ph, proot, pp, d);
+			pw = CHILD(ph, pp, !d);
+		}
+		if (!RED(CHILD(ph, pw, TCP_LEFT)) && !RED(CHILD(ph, pw, TCP_RIGHT)))
+		{
+			PAINT(ph, pw, true);
+			px = pp;
+			pp = PARENT(ph, px);
+		}
+		else
+		{
+			if (!RED(CHILD(ph, pw, !d)))
+			{
+				PAINT(ph, CHILD(ph, pw, d), false);
+				PAINT(ph, pw, true);
+				_nmTreeRotate(ph, proot, pw, !d);
+				pw = CHILD(ph, pp, !d);
+			}
+			PAINT(ph, pw, RED(pp));
+			PAINT(ph, pp, false);
+			PAINT(ph, CHILD(ph, pw, !d), false);
+			_nmTreeRotate(ph, proot, pp, d);
+			px = L2P(ph, *proot);
+			break;
+		}
+	}
+	if (NULL != px)
+		PAINT(ph, px, false);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTreeFit
+ * Description:   Find the smallest chunk that fits in the tree of the last entrance in O(log n).
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Aligned size in bytes.
+ * Return value:  Pointer to a free chunk or NULL. Of equal chunks the lowest one is taken.
+ */
+static P_FREE_CHUNK _nmTreeFit(P_HEAP_HEADER ph, size_t size)
+{
+	register P_FREE_CHUNK pfc = L2P(ph, HASH_TABLE(ph)[ph->hshsiz - 1]), pbest = NULL;
+
+	while (NULL != pfc)
+	{
+		if (size <= (HEAD_NOTE(pfc) & ~(size_t)MASK))
+		{
+			pbest = pfc;
+			pfc = CHILD(ph, pfc, TCP_LEFT);
+		}
+		else
+			pfc = CHILD(ph, pfc, TCP_RIGHT);
+	}
+	return pbest;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmBinFirst
+ * Description:   Get the first chunk of a hash table entrance to visit each of its chunks.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the entrance. It must be less than ph->hshsiz.
+ * Return value:  Pointer to a free chunk or NULL.
+ */
+static P_FREE_CHUNK _nmBinFirst(P_HEAP_HEADER ph, size_t i)
+{
+	register P_FREE_CHUNK pfc = L2P(ph, HASH_TABLE(ph)[i]);
+
+	if (NULL != pfc && TREE_BIN(ph, i))
+		while (NULL != CHILD(ph, pfc, TCP_LEFT))
+			pfc = CHILD(ph, pfc, TCP_LEFT);
+	return pfc;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmBinNext
+ * Description:   Get the chunk that follows pfc in its entrance. A tree is visited smallest first.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the entrance. It must be less than ph->hshsiz.
+ *        pfc Pointer to a free chunk in that entrance.
+ * Return value:  Pointer to a free chunk or NULL after the last one.
+ */
+static P_FREE_CHUNK _nmBinNext(P_HEAP_HEADER ph, size_t i, P_FREE_CHUNK pfc)
+{
+	register P_FREE_CHUNK pp;
+
+	if (!TREE_BIN(ph, i))
+		return (pfc = NEXT(ph, pfc)) == L2P(ph, HASH_TABLE(ph)[i]) ? NULL : pfc;
+
+	if (NULL != (pp = CHILD(ph, pfc, TCP_RIGHT)))
+	{
+		while (NULL != CHILD(ph, pp, TCP_LEFT))
+			pp = CHILD(ph, pp, TCP_LEFT);
+		return pp;
+	}
+	for (pp = PARENT(ph, pfc); NULL != pp && pfc == CHILD(ph, pp, TCP_RIGHT); pp = PARENT(ph, pfc))
+		pfc = pp;
+	return pp;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmUnlinkChunk
+ * Description:   Cut chunk off from linked list in constant time.
+ *                Chunks in the tree of a HF_BEST heap take O(log n).
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        ptr Pointer to a free chunk.
+ * Return value:  N/A.
+ */
+static void _nmUnlinkChunk(P_HEAP_HEADER ph, P_FREE_CHUNK ptr)
+{
+	register LINK * ppfc;
+
+	ppfc = _nmLocateHashTable(ph, _nmBinIndex(ph, HEAD_NOTE(ptr) & ~(size_t)MASK));
+
+	if (TREE_BIN(ph, (size_t)(ppfc - HASH_TABLE(ph))))
+	{
+		_nmTreeRemove(ph, ppfc, ptr);
+		if ((LINK)0 == *ppfc)
+			_nmMarkBin(ph, ppfc - HASH_TABLE(ph), false);
+	}
+	else if (ptr == NEXT(ph, ptr)) /* The only chunk in this linked list. */
+	{
+		*ppfc = (LINK)0;
+		_nmMarkBin(ph, ppfc - HASH_TABLE(ph), false);
+	}
+	else
+	{
+		PREV(ph, ptr)->p[FCP_NEXT] = ptr->p[FCP_NEXT];
+		NEXT(ph, ptr)->p[FCP_PREV] = ptr->p[FCP_PREV];
+
+		if (ptr == L2P(ph, *ppfc)) /* Reach at linked list header. */
+			*ppfc = ptr->p[FCP_NEXT];
+	}
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmRestoreEntrance
+ * Description:   Restore hash table entrance.
+ *                The chunk becomes the head of the list, or under HF_ADDRESS it goes in front of
+ *                the first chunk above it. The list is walked from its tail, since the chunks of
+ *                a heap that grows upwards tend to be freed in that order.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       ppfc Pointer to hash table entrance.
+ *        pfc Pointer to a free chunk.
+ * Return value:  N/A.
+ */
+static void _nmRestoreEntrance(P_HEAP_HEADER ph, LINK * ppfc, P_FREE_CHUNK pfc)
+{
+	register LINK l = P2L(ph, pfc);
+	register P_FREE_CHUNK phead, pnext;
+
+	if ((LINK)0 == *ppfc)
+		_nmMarkBin(ph, ppfc - HASH_TABLE(ph), true);
+
+	if (TREE_BIN(ph, (size_t)(ppfc - HASH_TABLE(ph))))
+	{
+		_nmTreeInsert(ph, ppfc, pfc);
+		return;
+	}
+
+	pfc->p[FCP_PREV] = pfc->p[FCP_NEXT] = l;
+	if ((LINK)0 != *ppfc)
+	{
+		pnext = phead = L2P(ph, *ppfc);
+		if ((HF_ADDRESS & ph->flags) && (size_t)pfc > (size_t)phead)
+		{	/* Go in front of the lowest chunk above pfc, or behind the tail. The head stays. */
+			l = *ppfc;
+			while ((size_t)PREV(ph, pnext) > (size_t)pfc)
+				pnext = PREV(ph, pnext);
+		}
+		pfc->p[FCP_NEXT] = P2L(ph, pnext);
+		pfc->p[FCP_PREV] = pnext->p[FCP_PREV];
+		PREV(ph, pnext)->p[FCP_NEXT] = P2L(ph, pfc);
+		pnext->p[FCP_PREV] = P2L(ph, pfc);
+	}
+	*ppfc = l;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFindBinAbove
+ * Description:   Find the nearest non-empty hash table entrance whose index is greater than or equal to i.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the current entrance.
+ * Return value:  Index of the entrance. ph->hshsiz means that there is no such entrance.
+ */
+static size_t _nmFindBinAbove(P_HEAP_HEADER ph, size_t i)
+{
+	register size_t * pbmp = BIN_BITMAP(ph);
+	register size_t w, m;
+
+	if (i >= ph->hshsiz)
+		return ph->hshsiz;
+
+	w = i / BMP_BITS;
+	m = pbmp[w] & (~(size_t)0 << (i % BMP_BITS));
+
+	if (0 == m)
+	{	/* Locate the bitmap word by summary. */
+		m = w + 1 < BMP_BITS ? BIN_SUMMARY(ph) & (~(size_t)0 << (w + 1)) : 0;
+		if (0 == m)
+			return ph->hshsiz;
+		w = _nmCTZ(m);
+		m = pbmp[w];
+	}
+	return w * BMP_BITS + _nmCTZ(m);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmScanBin
+ * Description:   Search one hash table entrance for the first chunk that fits.
+ *                HF_BEST heaps look for the smallest one instead, in the tree for the last entrance.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the entrance.
+ *       size Aligned size in bytes.
+ * Return value:  Pointer to a free chunk or NULL.
+ */
+static P_FREE_CHUNK _nmScanBin(P_HEAP_HEADER ph, size_t i, size_t size)
+{
+	register P_FREE_CHUNK pfc, pofc, pbest = NULL;
+	register size_t chksiz;
+
+	if (TREE_BIN(ph, i))
+		return _nmTreeFit(ph, size);
+
+	pfc = pofc = L2P(ph, *_nmLocateHashTable(ph, i));
+	if (NULL != pfc)
+	{
+		do
+		{
+			chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+			if (size <= chksiz)
+			{
+				if (!(HF_BEST & ph->flags) || size == chksiz)
+					return pfc;
+				if (NULL == pbest || chksiz < (HEAD_NOTE(pbest) & ~(size_t)MASK))
+					pbest = pfc;
+			}
+			pfc = NEXT(ph, pfc);
+		} while (pfc != pofc);
+	}
+	return pbest;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTakeBin
+ * Description:   Pick a chunk from an entrance whose chunks all fit.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *          i Index of the entrance. It must not be empty.
+ *       size Aligned size in bytes.
+ * Return value:  Pointer to a free chunk. The head, or the smallest chunk for HF_BEST heaps.
+ */
+static P_FREE_CHUNK _nmTakeBin(P_HEAP_HEADER ph, size_t i, size_t size)
+{
+	return (HF_BEST & ph->flags) ? _nmScanBin(ph, i, size) : L2P(ph, HASH_TABLE(ph)[i]);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFitFirst
+ * Description:   Power of two policy. First fit in the bin of size, otherwise take the head of a bigger bin.
+ *                HF_BEST heaps take the smallest chunk that fits in either bin.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Aligned size in bytes.
+ * Return value:  Pointer to a free chunk or NULL.
+ */
+static P_FREE_CHUNK _nmFitFirst(P_HEAP_HEADER ph, size_t size)
+{
+	register size_t j;
+	register P_FREE_CHUNK pfc;
+
+	j = _nmBinIndex(ph, size);
+	if (j >= ph->hshsiz)
+		j = ph->hshsiz - 1;
+
+	/* Search hash table. */
+	if (NULL != (pfc = _nmScanBin(ph, j, size)))
+		return pfc;
+
+	/* Jump to the next entrance that holds bigger chunks by scanning bitmap. Any of them fits. */
+	j = _nmFindBinAbove(ph, j + 1);
+	if (j >= ph->hshsiz)
+		return NULL; /* No available space. */
+
+	return _nmTakeBin(ph, j, size);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFitSegregated
+ * Description:   HF_TLSF policy. Round size up to the next sub-class, so that the head of
+ *                the first non-empty bin at or above it always fits. Two bit scans, no list walk.
+ *                HF_BEST heaps look for the smallest chunk in the exact sub-class first,
+ *                then in that bin, which costs a walk of both lists.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Aligned size in bytes.
+ * Return value:  Pointer to a free chunk or NULL.
+ */
+static P_FREE_CHUNK _nmFitSegregated(P_HEAP_HEADER ph, size_t size)
+{
+	register size_t i, j, l;
+	register P_FREE_CHUNK pfc;
+
+	i = _nmBinIndex(ph, size);
+	l = BMP_BITS - 1 - _nmCLZ(size >> _nmCTZ(ALIGN));
+	j = l > SLI(ph) ? _nmBinIndex(ph, size + ((size_t)1 << (l - SLI(ph) + _nmCTZ(ALIGN))) - 1) : i;
+
+	/* The exact sub-class may hold a chunk smaller than every chunk of the bins above it. */
+	if ((HF_BEST & ph->flags) && (NULL != (pfc = _nmScanBin(ph, i, size)) || i >= ph->hshsiz - 1))
+		return pfc;
+
+	if (j < ph->hshsiz)
+	{
+		j = _nmFindBinAbove(ph, j);
+		if (j < ph->hshsiz)
+			return _nmTakeBin(ph, j, size);
+	}
+
+	/* Sizes beyond the table share the last bin. Also try the exact sub-class before giving up. */
+	return _nmScanBin(ph, i, size);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmSplitChunk
+ * Description:   Split one chunk to two chunks and put back the latter one.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        pfc Pointer to a chunk to be split.
+ *       size Size of the former chunk.
+ * Return value:  The same chunk which is the same to pfc.
+ */
+static void * _nmSplitChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size)
+{
+	register void * pt;
+	register size_t i, z = HEAD_NOTE(pfc) & ZERO_MASK;
+
+	i = (HEAD_NOTE(pfc) & ~(size_t)MASK) - size - sizeof(TAG) * 2;
+	HEAD_NOTE(pfc) = size;
+	FOOT_NOTE(pfc) = size;
+	pt = pfc;
+	pfc = (P_FREE_CHUNK)((PUCHAR)pfc + size + sizeof(TAG) * 2);
+	HEAD_NOTE(pfc) = i;
+	FOOT_NOTE(pfc) = i;
+	/* The tail of a zero chunk is still zero beyond its links. */
+	HEAD_NOTE(pfc) |= FREE_MASK | z;
+	FOOT_NOTE(pfc) |= FREE_MASK | z;
+
+	STAT(ph, splits, 1);
+
+	/* Put new free chunk to the linked list the same way _nmUnlinkChunk expects to find it. */
+	_nmPutChunk(ph, pfc);
+
+	return pt;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmShrinkChunk
+ * Description:   Cut the tail off a used chunk and free it.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        pfc Pointer to a used chunk.
+ *       size New size of the chunk. Aligned and not greater than the current size.
+ * Return value:  The same chunk which is the same to pfc.
+ * Tip:           Tails smaller than MIN_CHUNK_SIZE are kept in the chunk.
+ *                The tail goes through nmFreeHeap, so it merges with a free chunk behind it.
+ */
+static void * _nmShrinkChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size)
+{
+	register size_t chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+	register P_FREE_CHUNK pt;
+
+	if (chksiz - size < MIN_CHUNK_SIZE)
+		return pfc;
+
+	HEAD_NOTE(pfc) = size;
+	FOOT_NOTE(pfc) = size;
+	pt = (P_FREE_CHUNK)((PUCHAR)pfc + size + 2 * sizeof(TAG));
+	HEAD_NOTE(pt) = chksiz - size - 2 * sizeof(TAG);
+	FOOT_NOTE(pt) = HEAD_NOTE(pt);
+	STAT(ph, usedsiz, -(chksiz - size));
+	STAT(ph, splits, 1);
+	_nmFreeChunk(ph, pt);
+
+	return pfc;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPutChunk
+ * Description:   Put free chunk back to linked list.
+ *                Chunks whose index exceeds the hash table share the last entrance,
+ *                so every free chunk can be found again.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        pfc Pointer to a free chunk.
+ * Return value:  N/A.
+ */
+static void _nmPutChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc)
+{
+	_nmRestoreEntrance(ph, _nmLocateHashTable(ph, _nmBinIndex(ph, HEAD_NOTE(pfc) & ~(size_t)MASK)), pfc);
+}
+
+/* Function name: nmCreateHeap
+ * Description:   Create a heap from a memory buffer.
+ * Parameters:
+ *      pbase Memory buffer starting address.
+ *       size Size of the whole buffer.(Unit in byte)
+ *     hshsiz Count of hash table entrances.
+ * Return value:  NULL: Failed.
+ *                Pointer to heap header(same as pbase): Succeeded.
+ * Tip:           Parameter size must be greater than or equal to
+ *                (sizeof(HEAP_HEADER) + (hshsiz * sizeof(P_FREE_CHUNK)) + ((BMP_SIZE(hshsiz) + 1) * sizeof(size_t)) + MIN_CHUNK_SIZE).
+ *                With one more word, every block is aligned to ALIGN if pbase is.
+ */
+P_HEAP_HEADER nmCreateHeap(void * pbase, size_t size, size_t hshsiz)
+{
+	return nmCreateHeapEx(pbase, size, hshsiz, HF_NONE);
+}
+
+/* Function name: nmCreateHeapEx
+ * Description:   Create a heap from a memory buffer with a bin policy.
+ * Parameters:
+ *      pbase Memory buffer starting address.
+ *       size Size of the whole buffer.(Unit in byte)
+ *     hshsiz Count of hash table entrances.
+ *      flags HF_NONE: Power of two bins with first fit, the same as nmCreateHeap.
+ *            HF_TLSF | HF_SLI(n): Two-level segregated fit with 2^n sub-classes per power of two.
+ *            HF_ZEROED may be added: The buffer and every later extension are zero-filled,
+ *            so nmCallocHeap can skip clearing memory that has never been handed out.
+ *            HF_ADDRESS may be added: Address-ordered first fit. Each bin is kept sorted,
+ *            which costs a walk of the bin on each free.
+ *            HF_BEST may be added: Best fit. The last entrance becomes a red-black tree.
+ *            Either placement keeps long-lived heaps less fragmented than plain first fit.
+ *            HF_QUICK may be added: Freed blocks of up to QUICK_MAX bytes stay used in quick lists
+ *            and are handed out again as they are. See nmSetHeapQuick.
+ * Return value:  NULL: Failed.
+ *                Pointer to heap header(same as pbase): Succeeded.
+ * Tip:           Parameter hshsiz must not exceed (sizeof(size_t) * CHAR_BIT) ^ 2.
+ *                Entrances are indexed by absolute chunk size. Every chunk size maps into the table
+ *                when hshsiz >= (log2(size / ALIGN) - n + 1) * 2^n, where n is 0 for HF_NONE.
+ *                Bigger chunks are kept together in the last entrance and are searched by first fit,
+ *                or in O(log n) by HF_BEST. Each node of that tree takes sizeof(TREE_CHUNK) bytes,
+ *                so HF_BEST needs hshsiz >= 3, where the last entrance holds no chunk smaller than that.
+ *                HF_TLSF allocates and frees in bounded time while no chunk falls into that last entrance.
+ *                Under NM_COMPACT parameter size must be less than 4 GiB.
+ */
+P_HEAP_HEADER nmCreateHeapEx(void * pbase, size_t size, size_t hshsiz, size_t flags)
+{
+	P_FREE_CHUNK pfc;
+	HEAP_HEADER hh;
+	size_t t;
+
+	if (NULL == pbase)
+		return NULL;
+
+	if (0 == hshsiz || BMP_SIZE(hshsiz) > BMP_BITS)
+		return NULL;
+
+	if (flags & ~(size_t)(HF_TLSF | HF_SLI_MASK | HF_ZEROED | HF_GROW | HF_ADDRESS | HF_BEST | HF_QUICK))
+		return NULL;
+	flags |= HF_LINKS;
+
+	/* Every chunk of the last entrance must have room for a tree node. */
+	hh.flags = flags;
+	if ((HF_BEST & flags) && _nmBinIndex(&hh, (sizeof(TREE_CHUNK) - 1) & ~(size_t)MASK) >= hshsiz - 1)
+		return NULL;
+
+	t = sizeof(HEAP_HEADER) + TABLE_SIZE(hshsiz) + ((HF_GROW & flags) ? sizeof(HEAP_GROWER) : 0) +
+		((HF_QUICK & flags) ? sizeof(HEAP_QUICK) : 0);
+
+	/* Shift chunks by one word if that aligns them to ALIGN and the buffer has room for it. */
+	if (sizeof(TAG) == (((size_t)pbase + t + sizeof(TAG)) & MASK) && size >= t + sizeof(TAG) + MIN_CHUNK_SIZE)
+	{
+		flags |= HF_PADDED;
+		t += sizeof(TAG);
+	}
+
+	if (size < t + MIN_CHUNK_SIZE || OUT_OF_REACH(pbase, pbase, size))
+		return NULL;
+
+	memset(&hh, 0, sizeof(HEAP_HEADER));
+	hh.size = size - t;
+	hh.size &= ~(size_t)MASK;
+	hh.hshsiz = hshsiz;
+	hh.flags = flags;
+
+	/* Set heap header. */
+	memcpy(pbase, &hh, sizeof(HEAP_HEADER));
+
+	/* Clear hash table, bitmap, region provider and quick lists. */
+	memset((PUCHAR)pbase + sizeof(HEAP_HEADER), 0, TABLE_SIZE(hshsiz) + ((HF_GROW & flags) ? sizeof(HEAP_GROWER) : 0) +
+		((HF_QUICK & flags) ? sizeof(HEAP_QUICK) : 0));
+	if (HF_QUICK & flags)
+		HEAP_QUICK(pbase)->limit = QUICK_LIMIT;
+
+	/* Set one free chunk. */
+	t = hh.size - (2 * sizeof(TAG));
+	if (t > ASIZE(t))
+		t = ASIZE(t);
+	else
+		t = t & ~(size_t)MASK;
+
+	pfc = (P_FREE_CHUNK)((PUCHAR)pbase + HEAP_BEGIN(&hh) + sizeof(TAG));
+	HEAD_NOTE(pfc) = t;
+	FOOT_NOTE(pfc) = t;
+	HEAD_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & flags) ? ZERO_MASK : 0);
+	FOOT_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & flags) ? ZERO_MASK : 0);
+
+	/* Set free chunk structure and hash table. */
+	_nmPutChunk((P_HEAP_HEADER)pbase, pfc);
+
+	return (P_HEAP_HEADER)pbase;
+}
+
+/* Function name: nmMeasureHeap
+ * Description:   Get the size of a buffer that holds a heap of a given size.
+ * Parameters:
+ *       size ph->size you want the heap to have at least.(Unit in byte)
+ *     hshsiz Count of hash table entrances.
+ *      flags Heap creation flags, see nmCreateHeapEx.
+ * Return value:  0: Size is too big.
+ *                Buffer size to pass to nmCreateHeapEx: Succeeded.
+ * Tip:           The result counts the padding word and the rounding of ph->size to ALIGN,
+ *                so it fits any starting address of the buffer.
+ */
+size_t nmMeasureHeap(size_t size, size_t hshsiz, size_t flags)
+{
+	HEAP_HEADER hh;
+	register size_t t;
+
+	hh.hshsiz = hshsiz;
+	hh.flags = flags | HF_PADDED;
+	t = HEAP_BEGIN(&hh) + MASK;
+
+	return size > (size_t)-1 - t ? 0 : size + t;
+}
+
+/* Function name: nmAttachHeap
+ * Description:   Take over a heap that was saved or mapped at another address.
+ * Parameters:
+ *      pbase Starting address of the heap header, which now lies here.
+ *       size Size of the memory that is mapped there.(Unit in byte)
+ * Return value:  NULL: Failed.
+ *                Pointer to heap header(same as pbase): Succeeded.
+ * Tip:           Only heaps built with NM_OFFSETS can be attached, and only by code built the same way.
+ *                Blocks are addressed by their offsets from the heap header, which stay the same.
+ *                The callbacks of a HF_GROW heap are dropped because they belong to the old process.
+ *                Set them again if needed. A heap with extra segments cannot be attached,
+ *                nor may it still own blocks mapped on their own.
+ *                Map the heap at the same alignment as before, such as on a page boundary.
+ *                Do not attach a heap that another thread or process is working on.
+ */
+P_HEAP_HEADER nmAttachHeap(void * pbase, size_t size)
+{
+	register P_HEAP_HEADER ph = (P_HEAP_HEADER)pbase;
+	register P_HEAP_GROWER pg;
+
+	if (NULL == pbase || size < sizeof(HEAP_HEADER))
+		return NULL;
+	/* Links of a pointer heap would still point into the old mapping. */
+	if (0 == HF_LINKS || HF_LINKS != ((HF_OFFSETS | HF_COMPACT) & ph->flags))
+		return NULL;
+	if (0 == ph->hshsiz || BMP_SIZE(ph->hshsiz) > BMP_BITS || size < HEAP_BEGIN(ph) ||
+		ph->size > size - HEAP_BEGIN(ph) || ph->size < MIN_CHUNK_SIZE)
+		return NULL;
+	/* A padded heap was aligned where it was built. */
+	if ((HF_PADDED & ph->flags) && (((size_t)pbase + HEAP_BEGIN(ph) + sizeof(TAG)) & MASK))
+		return NULL;
+
+	if (HF_GROW & ph->flags)
+	{
+		pg = HEAP_GROWER(ph);
+		if (NULL != pg->pseg)
+			return NULL;
+		pg->cbf    = NULL;
+		pg->pparam = NULL;
+		pg->cbp    = NULL;
+		pg->cbm    = NULL;
+	}
+	return ph;
+}
+
+/* Function name: nmExtendHeap
+ * Description:   Enlarge heap.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *    sizincl The incremental you want to extend.(Unit in byte)
+ * Return value:  NULL: Failed.
+ *                Pointer to heap header(same as ph): Succeeded.
+ * Tip:           Parameter sizincl must be greater than or equal to (MIN_CHUNK_SIZE).
+ */
+P_HEAP_HEADER nmExtendHeap(P_HEAP_HEADER ph, size_t sizincl)
+{
+	if (sizincl < MIN_CHUNK_SIZE || OUT_OF_REACH(ph, (PUCHAR)ph + HEAP_BEGIN(ph) + ph->size, sizincl))
+		return NULL;
+	else
+	{
+		/* Get the last chunk. */
+		bool bused;
+		size_t i;
+		PUCHAR phead;
+		P_FREE_CHUNK pfc;
+
+		phead = (PUCHAR)ph + HEAP_BEGIN(ph);
+		phead += ph->size - sizeof(TAG);
+
+		i = *(TAG *)phead;
+		bused = !!(i & FREE_MASK);
+
+		if (FREE != bused)
+		{
+			pfc = (P_FREE_CHUNK)(phead + sizeof(TAG) * 2);
+
+			sizincl &= ~(size_t)MASK;
+			ph->size += sizincl;
+			sizincl -= sizeof(TAG) * 2;
+
+			HEAD_NOTE(pfc) = sizincl;
+			FOOT_NOTE(pfc) = sizincl;
+			HEAD_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & ph->flags) ? ZERO_MASK : 0);
+			FOOT_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & ph->flags) ? ZERO_MASK : 0);
+
+			_nmPutChunk(ph, pfc);
+		}
+		else
+		{
+			phead -= (i & ~(size_t)MASK);
+			pfc = (P_FREE_CHUNK)phead;
+
+			sizincl &= ~(size_t)MASK;
+			ph->size += sizincl;
+			sizincl += i & ~(size_t)MASK;
+
+			/* Only the last chunk moves to another bin. The others stay valid. */
+			_nmUnlinkChunk(ph, pfc);
+
+			/* A zero chunk stays zero once its old foot note, now inside the payload, is cleared. */
+			if ((HF_ZEROED & ph->flags) && (i & ZERO_MASK))
+			{
+				FOOT_NOTE(pfc) = 0;
+				i = ZERO_MASK;
+			}
+			else
+				i = 0;
+
+			HEAD_NOTE(pfc) = sizincl;
+			FOOT_NOTE(pfc) = sizincl;
+			HEAD_NOTE(pfc) |= FREE_MASK | i;
+			FOOT_NOTE(pfc) |= FREE_MASK | i;
+
+			_nmPutChunk(ph, pfc);
+		}
+
+		return ph;
+	}
+}
+
+/* Function name: nmAddHeapSegment
+ * Description:   Give a heap a region that need not follow its end.
+ * Parameters:
+ *         ph Pointer to heap header. The heap must have been created with HF_GROW.
+ *      pbase Pointer to the region.
+ *       size Size of the region in bytes.
+ * Return value:  NULL: Failed.
+ *                Pointer to heap header(same as ph): Succeeded.
+ * Tip:           The region becomes one free chunk in the bins of the heap. A used sentinel tag
+ *                on each edge keeps merges inside the segment, so every segment can lie anywhere.
+ *                Parameter size must be at least (MIN_CHUNK_SIZE + 4 * sizeof(size_t) + ALIGN - 1).
+ *                Under NM_COMPACT the region must lie within 4 GiB above the heap header.
+ */
+P_HEAP_HEADER nmAddHeapSegment(P_HEAP_HEADER ph, void * pbase, size_t size)
+{
+	register P_HEAP_SEGMENT ps, * pps;
+	register P_FREE_CHUNK pfc;
+	register size_t t;
+
+	if (!(HF_GROW & ph->flags) || NULL == pbase || OUT_OF_REACH(ph, pbase, size))
+		return NULL;
+
+	/* Align the segment, so that its payloads are aligned to ALIGN. */
+	t = (((size_t)pbase + MASK) & ~(size_t)MASK) - (size_t)pbase;
+	if (size < t + SEG_OVERHEAD + MIN_CHUNK_SIZE)
+		return NULL;
+
+	ps = (P_HEAP_SEGMENT)((PUCHAR)pbase + t);
+	ps->pnext = NULL;
+	ps->size = (size - t - SEG_OVERHEAD) & ~(size_t)MASK;
+
+	/* Sentinels read as used chunks of size 0. */
+	*(TAG *)(SEG_BEGIN(ps) - sizeof(TAG)) = 0;
+	*(TAG *)(SEG_BEGIN(ps) + ps->size) = 0;
+
+	pfc = (P_FREE_CHUNK)(SEG_BEGIN(ps) + sizeof(TAG));
+	HEAD_NOTE(pfc) = ps->size - 2 * sizeof(TAG);
+	FOOT_NOTE(pfc) = HEAD_NOTE(pfc);
+	HEAD_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & ph->flags) ? ZERO_MASK : 0);
+	FOOT_NOTE(pfc) |= FREE_MASK | ((HF_ZEROED & ph->flags) ? ZERO_MASK : 0);
+
+	/* Append, so that segments keep their order for nmCheckHeapSlice. */
+	for (pps = &HEAP_GROWER(ph)->pseg; NULL != *pps; pps = &(*pps)->pnext)
+		;
+	*pps = ps;
+
+	_nmPutChunk(ph, pfc);
+
+	return ph;
+}
+
+/* Function name: nmSetHeapProvider
+ * Description:   Let a heap grow by itself when it runs out of room.
+ * Parameters:
+ *         ph Pointer to heap header. The heap must have been created with HF_GROW.
+ *        cbf Region provider. NULL stops the heap from growing.
+ *     pparam Parameter passed to cbf.
+ * Return value:  true:  Succeeded.
+ *                false: The heap has no room for a provider.
+ * Tip:           When an allocation finds no chunk, cbf is asked for a region. The heap asks for
+ *                at least the size of all its segments each time, so it doubles and the count
+ *                of calls stays logarithmic in the final size. If that fails, it asks again for
+ *                just enough to serve the allocation. A region at the end of the heap extends it,
+ *                any other region is added by nmAddHeapSegment.
+ */
+bool nmSetHeapProvider(P_HEAP_HEADER ph, CBF_REGION cbf, void * pparam)
+{
+	if (!(HF_GROW & ph->flags))
+		return false;
+
+	HEAP_GROWER(ph)->cbf    = cbf;
+	HEAP_GROWER(ph)->pparam = pparam;
+	return true;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmGrowHeap
+ * Description:   Extend a heap with a region from its provider.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Aligned payload size that the heap must be able to serve afterwards.
+ * Return value:  true:  The heap has grown.
+ *                false: No provider, or the provider refused.
+ */
+static bool _nmGrowHeap(P_HEAP_HEADER ph, size_t size)
+{
+	register P_HEAP_GROWER pg;
+	register P_HEAP_SEGMENT ps;
+	register size_t need, t;
+	register PUCHAR pend;
+	void * p;
+
+	if (!(HF_GROW & ph->flags) || NULL == (pg = HEAP_GROWER(ph))->cbf)
+		return false;
+
+	/* Enough for a chunk of size in a segment of its own. */
+	need = ASIZE(size + 2 * sizeof(TAG));
+	if (need < MIN_CHUNK_SIZE)
+		need = MIN_CHUNK_SIZE;
+	need += SEG_OVERHEAD + MASK;
+
+	pend = (PUCHAR)ph + HEAP_BEGIN(ph) + ph->size;
+
+	/* Double the heap if possible, otherwise take just what is needed. */
+	for (t = ph->size, ps = pg->pseg; NULL != ps; ps = ps->pnext)
+		t += ps->size;
+	t = (t & ~(size_t)MASK) > need ? t & ~(size_t)MASK : need;
+	if (NULL == (p = pg->cbf(t, pend, pg->pparam)))
+	{
+		if (t == need || NULL == (p = pg->cbf(need, pend, pg->pparam)))
+			return false;
+		t = need;
+	}
+
+	STAT(ph, grows, 1);
+	if (pend == (PUCHAR)p)
+		return NULL != nmExtendHeap(ph, t);
+	return NULL != nmAddHeapSegment(ph, p, t);
+}
+
+/* Function name: nmSetHeapPurger
+ * Description:   Let a heap give the pages of its free chunks back to the system.
+ * Parameters:
+ *         ph Pointer to heap header. The heap must have been created with HF_GROW.
+ *        cbf Page purger. It receives the pparam of nmSetHeapProvider. NULL turns purging off.
+ *       page Page size. A power of two, not less than ALIGN.
+ *     thresh Free chunks of at least thresh bytes are purged lazily. 0 leaves it to nmTrimHeap.
+ * Return value:  true:  Succeeded.
+ *                false: The heap has no room for a purger, or page is not valid.
+ * Tip:           Only whole pages between the links and the foot note of a free chunk are purged,
+ *                so the chunk stays in its bin and can be allocated as before.
+ *                Frees do not purge right away. Once PURGE_LAZY * thresh bytes have been freed into
+ *                chunks of at least thresh bytes, one pass purges every such chunk that is not purged yet.
+ */
+bool nmSetHeapPurger(P_HEAP_HEADER ph, CBF_PURGE cbf, size_t page, size_t thresh)
+{
+	if (!(HF_GROW & ph->flags) || page < ALIGN || (page & (page - 1)))
+		return false;
+
+	HEAP_GROWER(ph)->cbp    = cbf;
+	HEAP_GROWER(ph)->page   = page;
+	HEAP_GROWER(ph)->thresh = thresh;
+	HEAP_GROWER(ph)->dirty  = 0;
+	return true;
+}
+
+/* Function name: nmTrimHeap
+ * Description:   Purge the pages of free chunks now.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       keep Bytes of free chunks to leave alone. Smaller chunks are kept first.
+ * Return value:  Bytes handed to the purger. 0 if the heap has no purger.
+ * Tip:           Chunks that were purged before and have not been touched since are skipped.
+ *                Quick lists are flushed first, so their blocks can be purged too.
+ */
+size_t nmTrimHeap(P_HEAP_HEADER ph, size_t keep)
+{
+	if (!(HF_GROW & ph->flags) || NULL == HEAP_GROWER(ph)->cbp)
+		return 0;
+
+	_nmFlushQuick(ph);
+	return _nmPurgeFree(ph, HEAP_GROWER(ph)->page, keep);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPurgeFree
+ * Description:   Purge free chunks bin by bin, smallest bins first.
+ * Parameters:
+ *         ph Pointer to heap header. It has a purger.
+ *     minsiz Skip chunks smaller than this. Not less than ALIGN.
+ *       keep Bytes of free chunks to leave alone.
+ * Return value:  Bytes handed to the purger.
+ */
+static size_t _nmPurgeFree(P_HEAP_HEADER ph, size_t minsiz, size_t keep)
+{
+	register P_HEAP_GROWER pg = HEAP_GROWER(ph);
+	register P_FREE_CHUNK pfc;
+	register size_t i, lo, hi, chksiz, n = 0;
+
+	pg->dirty = 0;
+
+	i = _nmLocateHashTable(ph, _nmBinIndex(ph, minsiz)) - HASH_TABLE(ph);
+	for (i = _nmFindBinAbove(ph, i); i < ph->hshsiz; i = _nmFindBinAbove(ph, i + 1))
+	{
+		for (pfc = _nmBinFirst(ph, i); NULL != pfc; pfc = _nmBinNext(ph, i, pfc))
+		{
+			chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+			if (chksiz < minsiz || (HEAD_NOTE(pfc) & PURGE_MASK))
+				continue;
+			if (keep >= chksiz)
+			{
+				keep -= chksiz;
+				continue;
+			}
+
+			/* Whole pages behind the links and in front of the foot note. */
+			lo = ((size_t)pfc + NODE_SIZE(ph) + pg->page - 1) & ~(pg->page - 1);
+			hi = (size_t)&FOOT_NOTE(pfc) & ~(pg->page - 1);
+			if (lo < hi)
+			{
+				pg->cbp((void *)lo, hi - lo, pg->pparam);
+				n += hi - lo;
+			}
+			HEAD_NOTE(pfc) |= PURGE_MASK;
+			FOOT_NOTE(pfc) |= PURGE_MASK;
+		}
+	}
+
+	STAT(ph, purged, n);
+	return n;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmNoteFree
+ * Description:   Count a freed chunk for the lazy purge and purge when enough has been freed.
+ * Parameters:
+ *         ph Pointer to heap header. It has HF_GROW.
+ *       size Size of the free chunk after merging.
+ * Return value:  N/A.
+ */
+static void _nmNoteFree(P_HEAP_HEADER ph, size_t size)
+{
+	register P_HEAP_GROWER pg = HEAP_GROWER(ph);
+
+	if (NULL != pg->cbp && 0 != pg->thresh && size >= pg->thresh && (pg->dirty += size) >= PURGE_LAZY * pg->thresh)
+		_nmPurgeFree(ph, pg->thresh, 0);
+}
+
+/* Function name: nmSetHeapMapper
+ * Description:   Let a heap map huge blocks on their own.
+ * Parameters:
+ *         ph Pointer to heap header. The heap must have been created with HF_GROW.
+ *        cbf Mapper. It receives the pparam of nmSetHeapProvider. NULL turns mapping off.
+ *       gran Mappings are rounded up to a multiple of gran, such as the page size.
+ *            A power of two, not less than ALIGN.
+ *     thresh nmAllocHeap, nmCallocHeap and nmReallocHeap map blocks of at least thresh bytes.
+ * Return value:  true:  Succeeded.
+ *                false: The heap has no room for a mapper, or gran is not valid.
+ * Tip:           A mapped block never takes room in the segments, so freeing it leaves no hole.
+ *                nmFreeHeap unmaps it and nmReallocHeap remaps it, which moves pages instead of bytes
+ *                when the mapper can. Mapped blocks are not visited by nmWalkHeap or nmCheckHeap.
+ *                nmAllocAlignedHeap and nmAllocBatch never map.
+ *                Keep the mapper while mapped blocks are alive. It unmaps them.
+ */
+bool nmSetHeapMapper(P_HEAP_HEADER ph, CBF_REMAP cbf, size_t gran, size_t thresh)
+{
+	if (!(HF_GROW & ph->flags) || gran < ALIGN || (gran & (gran - 1)))
+		return false;
+
+	HEAP_GROWER(ph)->cbm     = cbf;
+	HEAP_GROWER(ph)->mapgran = gran;
+	HEAP_GROWER(ph)->mapmin  = thresh;
+	return true;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMapChunk
+ * Description:   Map a huge block if the heap has a mapper and the block is big enough.
+ * Parameters:
+ *         ph Pointer to heap header. It has HF_GROW.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: The block is not mapped. It may still be allocated in the heap.
+ *                Pointer to the zero-filled payload of a mapped block: Succeeded.
+ */
+static void * _nmMapChunk(P_HEAP_HEADER ph, size_t size)
+{
+	register P_HEAP_GROWER pg = HEAP_GROWER(ph);
+	register size_t t;
+	register size_t * p;
+
+	if (NULL == pg->cbm || size < pg->mapmin || size > MAX_BLOCK)
+		return NULL;
+
+	t = (ASIZE(size) + 2 * sizeof(size_t) + pg->mapgran - 1) & ~(pg->mapgran - 1);
+	if (NULL == (p = (size_t *)pg->cbm(NULL, 0, t, pg->pparam)))
+		return NULL;
+
+	p[0] = t;
+	HEAD_NOTE(p + 2) = (t - 2 * sizeof(size_t)) | MAP_MASK;
+
+	STAT(ph, allocs, 1);
+	STAT(ph, mapped, t);
+	return p + 2;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmRemapChunk
+ * Description:   Resize, move or unmap a mapped block.
+ * Parameters:
+ *         ph Pointer to heap header. It has HF_GROW.
+ *        pfc Pointer to a mapped block.
+ *       size New size in bytes. 0 unmaps the block.
+ * Return value:  NULL: Unmapped, or the mapper failed and the block is unchanged.
+ *                Pointer to the payload of the block: Succeeded.
+ */
+static void * _nmRemapChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t size)
+{
+	register P_HEAP_GROWER pg = HEAP_GROWER(ph);
+	register size_t * p = (size_t *)pfc - 2;
+	register size_t t = 0, old = p[0];
+
+	if (0 != size)
+	{
+		t = (ASIZE(size) + 2 * sizeof(size_t) + pg->mapgran - 1) & ~(pg->mapgran - 1);
+		if (t == old)
+			return pfc; /* The slack of the last page is enough. */
+	}
+
+	/* The mapper returns NULL after it unmaps, or when it fails to resize. */
+	if (NULL == (p = (size_t *)pg->cbm(p, old, t, pg->pparam)))
+	{
+		if (0 == size)
+			STAT(ph, mapped, -old);
+		return NULL;
+	}
+
+	STAT(ph, mapped, t - old);
+	p[0] = t;
+	HEAD_NOTE(p + 2) = (t - 2 * sizeof(size_t)) | MAP_MASK;
+	return p + 2;
+}
+
+/* Function name: nmSetHeapQuick
+ * Description:   Set how many freed blocks the quick lists of a heap may hold.
+ * Parameters:
+ *         ph Pointer to heap header. The heap must have been created with HF_QUICK.
+ *      limit The quick lists are flushed into the bins when they hold limit blocks.
+ *            0 flushes them and turns them off. nmCreateHeapEx sets QUICK_LIMIT.
+ * Return value:  true:  Succeeded.
+ *                false: The heap has no quick lists.
+ * Tip:           A freed block of up to QUICK_MAX bytes is neither merged nor put into a bin.
+ *                It stays used in the quick list of its size, and the next allocation of that size
+ *                takes it back in O(1). Quick lists are also flushed when no bin can serve
+ *                an allocation and by nmTrimHeap. nmWalkHeap reports their blocks as free,
+ *                and nmGetHeapStats counts them in quicksiz and quickcnt.
+ */
+bool nmSetHeapQuick(P_HEAP_HEADER ph, size_t limit)
+{
+	if (!(HF_QUICK & ph->flags))
+		return false;
+
+	HEAP_QUICK(ph)->limit = limit;
+	if (HEAP_QUICK(ph)->count >= limit)
+		_nmFlushQuick(ph);
+	return true;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFlushQuick
+ * Description:   Free every block of the quick lists into the bins.
+ * Parameters:
+ *         ph Pointer to heap header.
+ * Return value:  true:  Some blocks were freed.
+ *                false: The heap has no quick lists or they are empty.
+ */
+static bool _nmFlushQuick(P_HEAP_HEADER ph)
+{
+	register P_HEAP_QUICK pq;
+	register P_FREE_CHUNK pfc, pnext;
+	register size_t i;
+
+	if (!(HF_QUICK & ph->flags) || 0 == (pq = HEAP_QUICK(ph))->count)
+		return false;
+
+	for (i = 0; i < QUICK_BINS; ++i)
+	{
+		for (pfc = L2P(ph, pq->bin[i]); NULL != pfc; pfc = pnext)
+		{
+			pnext = L2P(ph, pfc->p[FCP_NEXT]);
+			HEAD_NOTE(pfc) &= ~(size_t)QUICK_MASK;
+			FOOT_NOTE(pfc) &= ~(size_t)QUICK_MASK;
+			_nmFreeChunk(ph, pfc);
+		}
+		pq->bin[i] = (LINK)0;
+	}
+	pq->count = 0;
+	return true;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmAllocChunk
+ * Description:   Heap allocation that also tells whether the block was taken from a zero chunk.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Size in bytes you want to allocate.
+ *      pzero Receives ZERO_MASK if the payload beyond the first NODE_SIZE(ph) bytes is zero, otherwise 0.
+ *            It can be NULL.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ */
+static void * _nmAllocChunk(P_HEAP_HEADER ph, size_t size, size_t * pzero)
+{
+	register P_FREE_CHUNK pfc;
+	register P_HEAP_QUICK pq;
+	
+	/* Rounding wraps to 0 near SIZE_MAX, so reject huge sizes first. */
+	if (size > MAX_BLOCK)
+	{
+		STAT(ph, fails, 1);
+		return NULL;
+	}
+
+	if (0 == size)
+		size = ALIGN;
+
+	size = ASIZE(size);
+
+	/* Take back a block of the same size from its quick list. */
+	if ((HF_QUICK & ph->flags) && size <= QUICK_MAX && NULL != (pfc = L2P(ph, (pq = HEAP_QUICK(ph))->bin[size / ALIGN - 1])))
+	{
+		pq->bin[size / ALIGN - 1] = pfc->p[FCP_NEXT];
+		--pq->count;
+		HEAD_NOTE(pfc) &= ~(size_t)MASK;
+		FOOT_NOTE(pfc) &= ~(size_t)MASK;
+		if (NULL != pzero)
+			*pzero = 0;
+
+		STAT(ph, allocs, 1);
+		STAT(ph, usedcnt, 1);
+		STAT(ph, usedsiz, size);
+		STAT(ph, quick, 1);
+		return pfc;
+	}
+
+	/* Definitely cannot allocate. */
+	if (CANNOT_FIT(ph, size))
+	{
+		STAT(ph, fails, 1);
+		return NULL;
+	}
+
+	if (HF_TLSF & ph->flags)
+		pfc = _nmFitSegregated(ph, size);
+	else
+		pfc = _nmFitFirst(ph, size);
+
+	/* Merge the blocks of quick lists into the bins, then ask the region provider for more room. */
+	if (NULL == pfc && _nmFlushQuick(ph))
+		pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, size) : _nmFitFirst(ph, size);
+	if (NULL == pfc && _nmGrowHeap(ph, size))
+		pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, size) : _nmFitFirst(ph, size);
+
+	if (NULL == pfc)
+	{
+		STAT(ph, fails, 1);
+		return NULL; /* No available space. */
+	}
+
+	if (NULL != pzero)
+		*pzero = HEAD_NOTE(pfc) & ZERO_MASK;
+
+	_nmUnlinkChunk(ph, pfc);
+
+	/* Cut one chunk. */
+	if (size == (HEAD_NOTE(pfc) & ~(size_t)MASK) || size > (HEAD_NOTE(pfc) & ~(size_t)MASK) - MIN_CHUNK_SIZE)
+	{	/* No need to split. Set used. */
+		HEAD_NOTE(pfc) &= ~(size_t)MASK;
+		FOOT_NOTE(pfc) &= ~(size_t)MASK;
+	}
+	else
+		_nmSplitChunk(ph, pfc, size); /* Split. */
+
+	STAT(ph, allocs, 1);
+	STAT(ph, usedcnt, 1);
+	STAT(ph, usedsiz, HEAD_NOTE(pfc));
+
+	return pfc;
+}
+
+/* Function name: nmAllocHeap
+ * Description:   Heap allocation.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ */
+void * nmAllocHeap(P_HEAP_HEADER ph, size_t size)
+{
+	register void * p;
+
+	if ((HF_GROW & ph->flags) && NULL != (p = _nmMapChunk(ph, size)))
+		return p;
+
+	return _nmAllocChunk(ph, size, NULL);
+}
+
+/* Function name: nmCallocHeap
+ * Description:   Allocate an array and clear it to zero.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        num Count of elements.
+ *       size Size in bytes of each element.
+ * Return value:  NULL: Failed.
+ *                Pointer to zero-filled heap memory: Succeeded.
+ * Tip:           For heaps created with HF_ZEROED, memory that has never been handed out
+ *                is known to be zero and only the old chunk links are cleared.
+ */
+void * nmCallocHeap(P_HEAP_HEADER ph, size_t num, size_t size)
+{
+	register void * p;
+	size_t z;
+
+	if (0 != num && size > (size_t)-1 / num)
+		return NULL;
+
+	size *= num;
+
+	/* Fresh mappings are zero. */
+	if ((HF_GROW & ph->flags) && NULL != (p = _nmMapChunk(ph, size)))
+		return p;
+
+	if (NULL != (p = _nmAllocChunk(ph, size, &z)))
+		memset(p, 0, z && size > NODE_SIZE(ph) ? NODE_SIZE(ph) : size);
+
+	return p;
+}
+
+/* Function name: nmAllocAlignedHeap
+ * Description:   Heap allocation with a bigger alignment than ALIGN.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *  alignment Alignment of the returned address. Must be a power of two.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address which is a multiple of alignment: Succeeded.
+ * Tip:           The slack before the aligned address becomes a free chunk of its own,
+ *                so the block can be freed or reallocated like any other block.
+ *                The heap must have been created on an address aligned to ALIGN.
+ */
+void * nmAllocAlignedHeap(P_HEAP_HEADER ph, size_t alignment, size_t size)
+{
+	register P_FREE_CHUNK pfc, pal;
+	register size_t chksiz;
+
+	if (0 == alignment || (alignment & (alignment - 1)))
+		return NULL;
+
+	if (alignment <= ALIGN)
+		return nmAllocHeap(ph, size);
+
+	/* Blocks of a heap whose base is not aligned to ALIGN cannot be aligned any better. */
+	if (((size_t)ph + HEAP_BEGIN(ph) + sizeof(TAG)) & MASK)
+		return NULL;
+
+	/* Rounding wraps to 0 near SIZE_MAX, so reject huge sizes first. */
+	if (size > MAX_BLOCK)
+		return NULL;
+
+	if (0 == size)
+		size = ALIGN;
+
+	size = ASIZE(size);
+
+	/* Definitely cannot allocate. */
+	if (CANNOT_FIT(ph, size) || CANNOT_FIT(ph, alignment) || ((HF_GROW & ph->flags) ? false : alignment > ph->size - size))
+		return NULL;
+
+	/* Room for the aligned block plus a leading chunk of at least MIN_CHUNK_SIZE. */
+	pfc = (P_FREE_CHUNK)_nmAllocChunk(ph, size + alignment + MIN_CHUNK_SIZE, NULL);
+	if (NULL == pfc)
+		return NULL;
+
+	if (0 == ((size_t)pfc & (alignment - 1)))
+		return _nmShrinkChunk(ph, pfc, size);
+
+	pal = (P_FREE_CHUNK)(((size_t)pfc + MIN_CHUNK_SIZE + alignment - 1) & ~(alignment - 1));
+	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+
+	/* Cut the chunk in front of the aligned address and free it. */
+	HEAD_NOTE(pal) = chksiz - (size_t)((PUCHAR)pal - (PUCHAR)pfc);
+	FOOT_NOTE(pal) = HEAD_NOTE(pal);
+	HEAD_NOTE(pfc) = (size_t)((PUCHAR)pal - (PUCHAR)pfc) - 2 * sizeof(TAG);
+	FOOT_NOTE(pfc) = HEAD_NOTE(pfc);
+	STAT(ph, usedsiz, -((PUCHAR)pal - (PUCHAR)pfc));
+	STAT(ph, splits, 1);
+	_nmFreeChunk(ph, pfc);
+
+	return _nmShrinkChunk(ph, pal, size);
+}
+
+/* Function name: nmAllocBatch
+ * Description:   Allocate a batch of blocks of the same size.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       size Size in bytes of each block.
+ *      count Count of blocks.
+ *        out Array of count pointers that receives the blocks.
+ * Return value:  Count of blocks allocated. Less than count means the heap is exhausted.
+ * Tip:           Blocks are carved side by side from as few free chunks as possible,
+ *                with one bin lookup per chunk. Each block can be freed on its own.
+ */
+size_t nmAllocBatch(P_HEAP_HEADER ph, size_t size, size_t count, void * out[])
+{
+	register P_FREE_CHUNK pfc;
+	register size_t n = 0, k, unit, rest, z;
+
+	/* Rounding wraps to 0 near SIZE_MAX, so reject huge sizes first. */
+	if (size > MAX_BLOCK)
+		return 0;
+
+	if (0 == size)
+		size = ALIGN;
+
+	size = ASIZE(size);
+
+	/* Definitely cannot allocate. */
+	if (CANNOT_FIT(ph, size))
+		return 0;
+
+	unit = size + 2 * sizeof(TAG);
+
+	while (n < count)
+	{
+		/* Look for one chunk that holds every remaining block, then for any chunk that holds one. */
+		k = count - n;
+		pfc = NULL;
+		if (k > 1 && k <= ph->size / unit)
+			pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, k * unit - 2 * sizeof(TAG)) : _nmFitFirst(ph, k * unit - 2 * sizeof(TAG));
+		if (NULL == pfc)
+			pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, size) : _nmFitFirst(ph, size);
+		if (NULL == pfc && _nmFlushQuick(ph))
+			pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, size) : _nmFitFirst(ph, size);
+		if (NULL == pfc && _nmGrowHeap(ph, k <= MAX_BLOCK / unit ? k * unit - 2 * sizeof(TAG) : size))
+			pfc = (HF_TLSF & ph->flags) ? _nmFitSegregated(ph, size) : _nmFitFirst(ph, size);
+		if (NULL == pfc)
+		{
+			STAT(ph, fails, 1);
+			break; /* No available space. */
+		}
+
+		_nmUnlinkChunk(ph, pfc);
+
+		z = HEAD_NOTE(pfc) & ZERO_MASK;
+		rest = (HEAD_NOTE(pfc) & ~(size_t)MASK) + 2 * sizeof(TAG);
+		if (k > rest / unit)
+			k = rest / unit;
+		rest -= k * unit;
+
+		/* Carve blocks. The last one keeps a tail that is too small to be a chunk. */
+		while (k--)
+		{
+			HEAD_NOTE(pfc) = size + (0 == k && rest < MIN_CHUNK_SIZE ? rest : 0);
+			FOOT_NOTE(pfc) = HEAD_NOTE(pfc);
+			STAT(ph, usedsiz, HEAD_NOTE(pfc));
+			out[n++] = pfc;
+			pfc = (P_FREE_CHUNK)((PUCHAR)pfc + unit);
+		}
+
+		if (rest >= MIN_CHUNK_SIZE)
+		{
+			HEAD_NOTE(pfc) = rest - 2 * sizeof(TAG);
+			FOOT_NOTE(pfc) = HEAD_NOTE(pfc);
+			HEAD_NOTE(pfc) |= FREE_MASK | z;
+			FOOT_NOTE(pfc) |= FREE_MASK | z;
+			STAT(ph, splits, 1);
+			_nmPutChunk(ph, pfc);
+		}
+	}
+
+	STAT(ph, allocs, n);
+	STAT(ph, usedcnt, n);
+	return n;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFreeChunk
+ * Description:   Free a used chunk and coalesce it with its free neighbours.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        ptr Pointer to a used chunk.
+ * Return value:  N/A.
+ */
+static void _nmFreeChunk(P_HEAP_HEADER ph, void * ptr)
+{
+	register P_FREE_CHUNK pfc = (P_FREE_CHUNK)ptr;
+	register bool bbtm = FREE, bhed = FREE;
+	register size_t upcolsiz, upcolcnt;
+	register size_t lwcolsiz, lwcolcnt;
+	register size_t chksiz;
+	register size_t i;
+	
+	if (NULL == ptr)
+		return;
+
+	/* Get upper bound. */
+	if (!HAS_PREV(ph, pfc))
+		bhed = USED;
+
+	upcolsiz = 0;
+	upcolcnt = 0;
+
+	do
+	{
+		if (FREE == bhed)
+		{
+			register size_t t = *(TAG *)((PUCHAR)pfc - 2 * sizeof(TAG));
+			chksiz = (t & ~(size_t)MASK);
+			if (FREE == !!(t & FREE_MASK))
+			{
+				pfc = (P_FREE_CHUNK)((PUCHAR)pfc - 2 * sizeof(TAG) - chksiz);
+				upcolsiz += chksiz;
+				++upcolcnt;
+
+				/* Unlink chunk. */
+				_nmUnlinkChunk(ph, pfc);
+			}
+			else
+				break;
+		}
+		else
+			break;
+
+		if (!HAS_PREV(ph, pfc))
+			bhed = USED;
+	} while (USED != bhed);
+
+	pfc = (P_FREE_CHUNK)ptr;
+
+	/* Get lower bound. */
+	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+
+	if (!HAS_NEXT(ph, pfc, chksiz))
+		bbtm = USED;
+
+	lwcolsiz = 0;
+	lwcolcnt = 0;
+
+	while (FREE == bbtm && FREE == !!(*(TAG *)((PUCHAR)pfc + chksiz + sizeof(TAG)) & FREE_MASK))
+	{
+		pfc = (P_FREE_CHUNK)((PUCHAR)pfc + chksiz + 2 * sizeof(TAG));
+		chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+		lwcolsiz += chksiz;
+		++lwcolcnt;
+
+		/* Unlink chunk. */
+		_nmUnlinkChunk(ph, pfc);
+		HEAD_NOTE(pfc) = 0;
+
+		if (!HAS_NEXT(ph, pfc, chksiz))
+			bbtm = USED;
+	}
+
+	/* Coalesce up and downward. */
+	pfc = (P_FREE_CHUNK)ptr;
+
+	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+
+	i = upcolsiz + sizeof(TAG) * 2 * upcolcnt;
+
+	/* Clear head notes that end up inside the merged chunk,
+	 * so that nmCheckHeapSlice never takes a stale pair of tags for a chunk.
+	 */
+	if (upcolcnt)
+	{
+		HEAD_NOTE(pfc) = 0;
+		pfc = (P_FREE_CHUNK)((PUCHAR)pfc - i);
+	}
+
+	chksiz += i;
+
+	chksiz += lwcolsiz + sizeof(TAG) * 2 * lwcolcnt;
+
+	HEAD_NOTE(pfc) = chksiz;
+	FOOT_NOTE(pfc) = chksiz;
+	HEAD_NOTE(pfc) |= FREE_MASK;
+	FOOT_NOTE(pfc) |= FREE_MASK;
+
+	STAT(ph, merges, upcolcnt + lwcolcnt);
+
+	/* Put free chunk back into hash table or leave it alone. */
+	_nmPutChunk(ph, pfc);
+
+	if (HF_GROW & ph->flags)
+		_nmNoteFree(ph, chksiz);
+}
+
+/* Function name: nmFreeHeap
+ * Description:   Heap freedom.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        ptr Pointer in heap that you want to free.
+ * Return value:  N/A.
+ * Tip:           Under HF_QUICK a block of up to QUICK_MAX bytes goes to a quick list instead of a bin.
+ */
+void nmFreeHeap(P_HEAP_HEADER ph, void * ptr)
+{
+	register P_FREE_CHUNK pfc = (P_FREE_CHUNK)ptr;
+	register P_HEAP_QUICK pq;
+	register size_t chksiz;
+
+	if (NULL == ptr)
+		return;
+
+	STAT(ph, frees, 1);
+	if (MAPPED(pfc))
+	{
+		_nmRemapChunk(ph, pfc, 0);
+		return;
+	}
+	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+	STAT(ph, usedcnt, -1);
+	STAT(ph, usedsiz, -chksiz);
+
+	/* A small block waits in the quick list of its size. It stays used, so nothing merges with it. */
+	if ((HF_QUICK & ph->flags) && chksiz <= QUICK_MAX && 0 != (pq = HEAP_QUICK(ph))->limit)
+	{
+		HEAD_NOTE(pfc) |= QUICK_MASK;
+		FOOT_NOTE(pfc) |= QUICK_MASK;
+		pfc->p[FCP_NEXT] = pq->bin[chksiz / ALIGN - 1];
+		pq->bin[chksiz / ALIGN - 1] = P2L(ph, pfc);
+		if (++pq->count >= pq->limit)
+			_nmFlushQuick(ph);
+		return;
+	}
+
+	_nmFreeChunk(ph, ptr);
+}
+
+/* Function name: nmFreeBatch
+ * Description:   Free a batch of blocks.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       ptrs Array of pointers in heap. NULL pointers are skipped.
+ *      count Count of pointers.
+ * Return value:  N/A.
+ * Tip:           Blocks that lie side by side are merged into one chunk, so bins are touched
+ *                once per run of blocks, not once per block. Runs are found by marking every block
+ *                first, which costs O(count) and needs no sorting.
+ */
+void nmFreeBatch(P_HEAP_HEADER ph, void * ptrs[], size_t count)
+{
+	register P_FREE_CHUNK pfc, pbeg, pend;
+	register size_t i, t, chksiz;
+
+	/* Mark blocks pending: free flag set but not linked into any bin. */
+	for (i = 0; i < count; ++i)
+	{
+		if (NULL == (pfc = (P_FREE_CHUNK)ptrs[i]) || MAPPED(pfc))
+			continue;
+		STAT(ph, frees, 1);
+		STAT(ph, usedcnt, -1);
+		STAT(ph, usedsiz, -(HEAD_NOTE(pfc) & ~(size_t)MASK));
+		HEAD_NOTE(pfc) |= FREE_MASK;
+		FOOT_NOTE(pfc) |= FREE_MASK;
+		pfc->p[FCP_PREV] = (LINK)0;
+	}
+
+	for (i = 0; i < count; ++i)
+	{
+		pfc = (P_FREE_CHUNK)ptrs[i];
+
+		if (NULL != pfc && MAPPED(pfc))
+		{
+			STAT(ph, frees, 1);
+			_nmRemapChunk(ph, pfc, 0);
+			continue;
+		}
+
+		/* Blocks of a run that has been merged are no longer pending. */
+		if (NULL == pfc || !PENDING(pfc))
+			continue;
+
+		/* Go back to the first block of the run. */
+		for (pbeg = pfc; HAS_PREV(ph, pbeg) && (*(TAG *)((PUCHAR)pbeg - 2 * sizeof(TAG)) & FREE_MASK); pbeg = pend)
+		{
+			t = *(TAG *)((PUCHAR)pbeg - 2 * sizeof(TAG)) & ~(size_t)MASK;
+			pend = (P_FREE_CHUNK)((PUCHAR)pbeg - 2 * sizeof(TAG) - t);
+			if (!PENDING(pend))
+				break;
+		}
+
+		/* Go forward to the last block of the run and clear marks on the way. */
+		for (pend = pbeg; ; pend = pfc)
+		{
+			pend->p[FCP_PREV] = P2L(ph, pend);
+			t = HEAD_NOTE(pend) & ~(size_t)MASK;
+			if (pend != pbeg)
+				HEAD_NOTE(pend) = 0;
+			if (!HAS_NEXT(ph, pend, t))
+				break;
+			pfc = (P_FREE_CHUNK)((PUCHAR)pend + t + 2 * sizeof(TAG));
+			if (!PENDING(pfc))
+				break;
+			STAT(ph, merges, 1);
+		}
+		chksiz = (size_t)((PUCHAR)pend - (PUCHAR)pbeg) + t;
+
+		/* Any other free neighbour is a real free chunk, or the run would have covered it. */
+		if (HAS_NEXT(ph, pend, t) && (*(TAG *)((PUCHAR)pend + t + sizeof(TAG)) & FREE_MASK))
+		{
+			pfc = (P_FREE_CHUNK)((PUCHAR)pend + t + 2 * sizeof(TAG));
+			_nmUnlinkChunk(ph, pfc);
+			chksiz += (HEAD_NOTE(pfc) & ~(size_t)MASK) + 2 * sizeof(TAG);
+			HEAD_NOTE(pfc) = 0;
+			STAT(ph, merges, 1);
+		}
+		if (HAS_PREV(ph, pbeg) && (*(TAG *)((PUCHAR)pbeg - 2 * sizeof(TAG)) & FREE_MASK))
+		{
+			t = *(TAG *)((PUCHAR)pbeg - 2 * sizeof(TAG)) & ~(size_t)MASK;
+			HEAD_NOTE(pbeg) = 0;
+			pbeg = (P_FREE_CHUNK)((PUCHAR)pbeg - 2 * sizeof(TAG) - t);
+			_nmUnlinkChunk(ph, pbeg);
+			chksiz += t + 2 * sizeof(TAG);
+			STAT(ph, merges, 1);
+		}
+
+		HEAD_NOTE(pbeg) = chksiz;
+		FOOT_NOTE(pbeg) = chksiz;
+		HEAD_NOTE(pbeg) |= FREE_MASK;
+		FOOT_NOTE(pbeg) |= FREE_MASK;
+		_nmPutChunk(ph, pbeg);
+
+		if (HF_GROW & ph->flags)
+			_nmNoteFree(ph, chksiz);
+	}
+}
+
+/* Function name: nmReallocHeap
+ * Description:   Heap reallocation.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        ptr Pointer in heap that you want to reallocate.
+ *       size New size of memory chunk.
+ * Return value:  NULL: Reallocation failed.
+ *                Pointer to heap memory: Succeeded.
+ * Tip:           The return value can either be ptr or a new address or NULL.
+ *                Free space before and after the block is tried before a new allocation,
+ *                so the block may slide down to the address of its preceding free neighbour.
+ */
+void * nmReallocHeap(P_HEAP_HEADER ph, void * ptr, size_t size)
+{
+	register P_FREE_CHUNK pfc = (P_FREE_CHUNK)ptr;
+	register P_FREE_CHUNK pprv = NULL, pnxt = NULL;
+	register size_t chksiz, prvsiz = 0, nxtsiz = 0;
+	register void * pr;
+
+	if (NULL == ptr)
+		return nmAllocHeap(ph, size);
+	else if (0 == size)
+	{
+		nmFreeHeap(ph, ptr);
+		return NULL;
+	}
+
+	/* Rounding wraps to 0 near SIZE_MAX, so reject huge sizes first. */
+	if (size > MAX_BLOCK)
+		return NULL;
+
+	size = ASIZE(size);
+
+	/* Definitely cannot allocate. */
+	if (CANNOT_FIT(ph, size))
+		return NULL;
+
+	chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+
+	if (MAPPED(pfc))
+	{	/* Huge blocks stay mapped and smaller ones move into the heap. */
+		if (size >= HEAP_GROWER(ph)->mapmin)
+			return _nmRemapChunk(ph, pfc, size);
+		if (NULL != (pr = _nmAllocChunk(ph, size, NULL)))
+		{
+			memcpy(pr, pfc, size < chksiz ? size : chksiz);
+			nmFreeHeap(ph, pfc);
+		}
+		return pr;
+	}
+
+	if (size <= chksiz)
+		return _nmShrinkChunk(ph, pfc, size);
+
+	/* Free neighbours are always coalesced, so there is at most one on each side. */
+	if (HAS_NEXT(ph, pfc, chksiz) && (*(TAG *)((PUCHAR)pfc + chksiz + sizeof(TAG)) & FREE_MASK))
+	{
+		pnxt = (P_FREE_CHUNK)((PUCHAR)pfc + chksiz + 2 * sizeof(TAG));
+		nxtsiz = (HEAD_NOTE(pnxt) & ~(size_t)MASK) + 2 * sizeof(TAG);
+	}
+	if (HAS_PREV(ph, pfc) && (*(TAG *)((PUCHAR)pfc - 2 * sizeof(TAG)) & FREE_MASK))
+	{
+		prvsiz = (*(TAG *)((PUCHAR)pfc - 2 * sizeof(TAG)) & ~(size_t)MASK) + 2 * sizeof(TAG);
+		pprv = (P_FREE_CHUNK)((PUCHAR)pfc - prvsiz);
+	}
+
+	if (chksiz + nxtsiz >= size)
+	{	/* Grow forward in place. */
+		_nmUnlinkChunk(ph, pnxt);
+		HEAD_NOTE(pnxt) = 0;
+		STAT(ph, merges, 1);
+		STAT(ph, usedsiz, nxtsiz);
+		chksiz += nxtsiz;
+		HEAD_NOTE(pfc) = chksiz;
+		FOOT_NOTE(pfc) = chksiz;
+		return _nmShrinkChunk(ph, pfc, size);
+	}
+	else if (NULL != pprv && chksiz + nxtsiz + prvsiz >= size)
+	{	/* Absorb the preceding chunk too and slide the payload down. */
+		_nmUnlinkChunk(ph, pprv);
+		if (NULL != pnxt)
+		{
+			_nmUnlinkChunk(ph, pnxt);
+			HEAD_NOTE(pnxt) = 0;
+		}
+		STAT(ph, merges, NULL != pnxt ? 2 : 1);
+		STAT(ph, usedsiz, nxtsiz + prvsiz);
+		HEAD_NOTE(pfc) = 0; /* Before the move, which may cover it with payload. */
+		memmove(pprv, pfc, chksiz);
+		chksiz += nxtsiz + prvsiz;
+		HEAD_NOTE(pprv) = chksiz;
+		FOOT_NOTE(pprv) = chksiz;
+		return _nmShrinkChunk(ph, pprv, size);
+	}
+
+	/* Move to a fresh chunk. */
+	pr = nmAllocHeap(ph, size);
+	if (NULL != pr)
+	{
+		memcpy(pr, pfc, chksiz);
+		nmFreeHeap(ph, pfc);
+	}
+	return pr;
+}
+
+/* Function name: nmSizeHeap
+ * Description:   Get usable size of an allocated block.
+ * Parameter:
+ *        ptr Pointer in heap returned by nmAllocHeap or nmReallocHeap.
+ * Return value:  Usable size in bytes. It may be bigger than the size that was asked for.
+ */
+size_t nmSizeHeap(void * ptr)
+{
+	if (NULL == ptr)
+		return 0;
+	return HEAD_NOTE((P_FREE_CHUNK)ptr) & ~(size_t)MASK;
+}
+
+/* Function name: nmGetHeapStats
+ * Description:   Get statistics of a heap.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        pst Pointer to statistics. Set pst->pbin before calling if per-bin counts are wanted.
+ * Return value:  N/A.
+ * Tip:           Counters are copied in O(1). Free chunk figures walk every bin once,
+ *                so the cost grows with the count of free chunks, not with the heap size.
+ */
+void nmGetHeapStats(P_HEAP_HEADER ph, P_HEAP_STATS pst)
+{
+	register size_t i, j, n, chksiz;
+	register P_FREE_CHUNK pfc;
+
+#ifdef NM_STATS
+	pst->cnt = ph->cnt;
+#else
+	memset(&pst->cnt, 0, sizeof(HEAP_COUNTERS));
+#endif
+	pst->freesiz = pst->freecnt = pst->maxfree = 0;
+	pst->quicksiz = pst->quickcnt = 0;
+	memset(pst->lenhist, 0, sizeof(pst->lenhist));
+
+	if (HF_QUICK & ph->flags)
+	{
+		for (i = 0; i < QUICK_BINS; ++i)
+		{
+			for (pfc = L2P(ph, HEAP_QUICK(ph)->bin[i]); NULL != pfc; pfc = L2P(ph, pfc->p[FCP_NEXT]))
+			{
+				pst->quicksiz += (i + 1) * ALIGN;
+				++pst->quickcnt;
+			}
+		}
+	}
+
+	for (i = 0; i < ph->hshsiz; ++i)
+	{
+		n = 0;
+		for (pfc = _nmBinFirst(ph, i); NULL != pfc; pfc = _nmBinNext(ph, i, pfc))
+		{
+			chksiz = HEAD_NOTE(pfc) & ~(size_t)MASK;
+			pst->freesiz += chksiz;
+			if (chksiz > pst->maxfree)
+				pst->maxfree = chksiz;
+			++n;
+		}
+		pst->freecnt += n;
+		if (NULL != pst->pbin)
+			pst->pbin[i] = n;
+
+		j = 0 == n ? 0 : BMP_BITS - _nmCLZ(n);
+		++pst->lenhist[j < HS_LENGTHS ? j : HS_LENGTHS - 1];
+	}
+}
+
+/* Function name: nmWalkHeap
+ * Description:   Visit every chunk of a heap in address order.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        cbf Callback. It receives the payload, its usable size, whether the chunk is free and pparam.
+ *     pparam Parameter passed to cbf.
+ * Return value:  0: Every chunk was visited.
+ *                Otherwise: The value returned by cbf that stopped the walk.
+ * Tip:           The walk follows head notes only. Use nmCheckHeap first if the heap may be corrupted.
+ *                The payload of a free chunk starts with its links, cbf must not change them.
+ *                Blocks that wait in quick lists are reported as free.
+ *                Extra segments are visited after the heap itself in the order they were added.
+ */
+int nmWalkHeap(P_HEAP_HEADER ph, CBF_WALK cbf, void * pparam)
+{
+	register PUCHAR q = (PUCHAR)ph + HEAP_BEGIN(ph), pend = q + ph->size;
+	register P_HEAP_SEGMENT ps = FIRST_SEGMENT(ph);
+	register size_t h;
+	register int r;
+
+	for ( ; ; )
+	{
+		for ( ; q < pend; q += (h & ~(size_t)MASK) + 2 * sizeof(TAG))
+		{
+			h = *(TAG *)q;
+			if (0 != (r = cbf(q + sizeof(TAG), h & ~(size_t)MASK, (h & FREE_MASK) || QUICKED(h), pparam)))
+				return r;
+		}
+		if (NULL == ps)
+			return 0;
+		q = SEG_BEGIN(ps);
+		pend = q + ps->size;
+		ps = ps->pnext;
+	}
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmIsChunk
+ * Description:   Tell whether a link points at a chunk with matching tags inside the heap.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *        pfc Pointer to be tested.
+ *       bits FREE_MASK for a free chunk or QUICK_MASK for a chunk in a quick list.
+ * Return value:  true or false.
+ */
+static bool _nmIsChunk(P_HEAP_HEADER ph, P_FREE_CHUNK pfc, size_t bits)
+{
+	register PUCHAR pbgn = (PUCHAR)ph + HEAP_BEGIN(ph), pend = pbgn + ph->size;
+	register P_HEAP_SEGMENT ps = FIRST_SEGMENT(ph);
+	register size_t h;
+
+	/* Find the segment that holds pfc. */
+	while ((PUCHAR)pfc < pbgn || (PUCHAR)pfc >= pend)
+	{
+		if (NULL == ps)
+			return false;
+		pbgn = SEG_BEGIN(ps);
+		pend = pbgn + ps->size;
+		ps = ps->pnext;
+	}
+
+	/* Every payload lies one word past a multiple of ALIGN from pbgn. */
+	if ((PUCHAR)pfc < pbgn + sizeof(TAG) || (PUCHAR)pfc > pend - MIN_CHUNK_SIZE + sizeof(TAG) ||
+		0 != ((PUCHAR)pfc - pbgn - sizeof(TAG)) % ALIGN)
+		return false;
+
+	h = HEAD_NOTE(pfc);
+	return bits == (h & (FREE_MASK | bits)) && (h & ~(size_t)MASK) + sizeof(TAG) <= (size_t)(pend - (PUCHAR)pfc) && h == FOOT_NOTE(pfc);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmCheckChunk
+ * Description:   Check one chunk in constant time.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       pend End of the segment.
+ *        pfc Pointer to the payload of the chunk.
+ *      bprev Whether the chunk before it is free.
+ * Return value:  HC_OK or one of the errors of en_HeapCheck.
+ * Tip:           A free chunk passes if its neighbours in the list link back to it,
+ *                they belong to the same bin and that bin is marked in the bitmap.
+ *                A chunk in a tree links to itself. Its children and its parent must link back to it,
+ *                and its children must be on the right side of it.
+ */
+static int _nmCheckChunk(P_HEAP_HEADER ph, PUCHAR pend, P_FREE_CHUNK pfc, bool bprev)
+{
+	register size_t h = HEAD_NOTE(pfc), i, d;
+	register P_FREE_CHUNK pn, pp;
+
+	if ((h & ~(size_t)MASK) + sizeof(TAG) > (size_t)(pend - (PUCHAR)pfc) || h != FOOT_NOTE(pfc))
+		return HC_BAD_TAG;
+	if (!(h & FREE_MASK))	/* Only heaps with quick lists have used chunks with a mark. */
+		return QUICKED(h) && (!(HF_QUICK & ph->flags) || (h & ~(size_t)MASK) > QUICK_MAX) ? HC_BAD_TAG : HC_OK;
+	if (bprev)
+		return HC_ADJ_FREE;
+
+	pn = NEXT(ph, pfc);
+	pp = PREV(ph, pfc);
+	if (!_nmIsChunk(ph, pn, FREE_MASK) || !_nmIsChunk(ph, pp, FREE_MASK) ||
+		pfc != PREV(ph, pn) || pfc != NEXT(ph, pp))
+		return HC_BAD_LINK;
+
+	i = _nmLocateHashTable(ph, _nmBinIndex(ph, h & ~(size_t)MASK)) - HASH_TABLE(ph);
+	if (i != (size_t)(_nmLocateHashTable(ph, _nmBinIndex(ph, HEAD_NOTE(pn) & ~(size_t)MASK)) - HASH_TABLE(ph)))
+		return HC_BAD_LINK;
+	if ((LINK)0 == HASH_TABLE(ph)[i] || !(BIN_BITMAP(ph)[i / BMP_BITS] & ((size_t)1 << (i % BMP_BITS))))
+		return HC_UNLINKED;
+
+	if (TREE_BIN(ph, i))
+	{
+		if (pfc != pn)
+			return HC_BAD_LINK;
+		for (d = TCP_LEFT; d <= TCP_RIGHT; ++d)
+			if (NULL != (pn = CHILD(ph, pfc, d)) &&
+				(!_nmIsChunk(ph, pn, FREE_MASK) || pfc != PARENT(ph, pn) || _nmTreeLess(pn, pfc) != (TCP_LEFT == d)))
+				return HC_BAD_LINK;
+		if (NULL == (pp = PARENT(ph, pfc)) ? pfc != L2P(ph, HASH_TABLE(ph)[i]) :
+			!_nmIsChunk(ph, pp, FREE_MASK) || (pfc != CHILD(ph, pp, TCP_LEFT) && pfc != CHILD(ph, pp, TCP_RIGHT)))
+			return HC_BAD_LINK;
+	}
+
+	return HC_OK;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmCheckRange
+ * Description:   Check chunks in address order from an offset.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       pcur Pointer to the offset of the first chunk. Offsets count the chunks of the heap itself
+ *            from HEAP_BEGIN(ph), then those of every extra segment in turn.
+ *            Receives the offset of the next chunk, 0 after the last one, or the bad chunk on error.
+ *       nchk Count of chunks to check. 0 means up to the end of the heap.
+ *     pnfree Receives the count of free chunks that were checked.
+ *    pnquick Receives the count of chunks in quick lists that were checked.
+ * Return value:  HC_OK or one of the errors of en_HeapCheck.
+ */
+static int _nmCheckRange(P_HEAP_HEADER ph, size_t * pcur, size_t nchk, size_t * pnfree, size_t * pnquick)
+{
+	register PUCHAR pbgn = (PUCHAR)ph + HEAP_BEGIN(ph), pend = pbgn + ph->size, q;
+	register P_HEAP_SEGMENT ps = FIRST_SEGMENT(ph);
+	register size_t h, base = 0; /* Offset of pbgn. */
+	register bool bprev = false;
+	register int r;
+
+	*pnfree = *pnquick = 0;
+
+	/* Find the segment of the cursor. */
+	while (*pcur - base >= (size_t)(pend - pbgn) && NULL != ps)
+	{
+		base += (size_t)(pend - pbgn);
+		pbgn = SEG_BEGIN(ps);
+		pend = pbgn + ps->size;
+		ps = ps->pnext;
+	}
+
+	q = pbgn + (*pcur - base);
+	if (*pcur - base >= (size_t)(pend - pbgn) || 0 != *pcur % ALIGN)
+	{	/* Start over. */
+		base = 0;
+		q = pbgn = (PUCHAR)ph + HEAP_BEGIN(ph);
+		pend = pbgn + ph->size;
+		ps = FIRST_SEGMENT(ph);
+	}
+	else if (q > pbgn)
+	{	/* The heap may have changed since the last slice. Go on only if q still starts a chunk. */
+		h = *(TAG *)(q - sizeof(TAG));
+		if (0 == *(TAG *)q || (h & ~(size_t)MASK) > (size_t)(q - pbgn) - 2 * sizeof(TAG) ||
+			h != *(TAG *)(q - (h & ~(size_t)MASK) - 2 * sizeof(TAG)))
+			q = pbgn;
+		else
+			bprev = !!(h & FREE_MASK);
+	}
+
+	for ( ; ; )
+	{
+		if (HC_OK != (r = _nmCheckChunk(ph, pend, (P_FREE_CHUNK)(q + sizeof(TAG)), bprev)))
+		{
+			*pcur = base + (size_t)(q - pbgn);
+			return r;
+		}
+		h = *(TAG *)q;
+		if ((bprev = !!(h & FREE_MASK)))
+			++*pnfree;
+		else if (QUICKED(h))
+			++*pnquick;
+		q += (h & ~(size_t)MASK) + 2 * sizeof(TAG);
+
+		if (q >= pend)
+		{	/* Go on with the next segment. Its sentinels must still read as used. */
+			if (NULL == ps)
+			{
+				*pcur = 0;
+				return HC_OK;
+			}
+			base += (size_t)(pend - pbgn);
+			q = pbgn = SEG_BEGIN(ps);
+			pend = pbgn + ps->size;
+			ps = ps->pnext;
+			bprev = false;
+			if (0 != *(TAG *)(pbgn - sizeof(TAG)) || 0 != *(TAG *)pend)
+			{
+				*pcur = base;
+				return HC_BAD_TAG;
+			}
+		}
+
+		if (0 == --nchk)
+			break;
+	}
+
+	*pcur = base + (size_t)(q - pbgn);
+	return HC_OK;
+}
+
+/* Function name: nmCheckHeap
+ * Description:   Check the whole heap for corruption.
+ * Parameter:
+ *         ph Pointer to heap header.
+ * Return value:  HC_OK or one of the errors of en_HeapCheck.
+ * Tip:           Allocation free and O(n) in the count of chunks. Besides the per chunk tests of
+ *                nmCheckHeapSlice, every bin and quick list is walked once, so a free chunk that no bin
+ *                reaches is found.
+ */
+int nmCheckHeap(P_HEAP_HEADER ph)
+{
+	register size_t i, n = 0;
+	register P_FREE_CHUNK pfc;
+	size_t cur = 0, nfree, nquick;
+	register int r;
+
+	if (HC_OK != (r = _nmCheckRange(ph, &cur, 0, &nfree, &nquick)))
+		return r;
+
+	for (i = 0; i < ph->hshsiz; ++i)
+	{
+		pfc = L2P(ph, HASH_TABLE(ph)[i]);
+		if ((NULL != pfc) != !!(BIN_BITMAP(ph)[i / BMP_BITS] & ((size_t)1 << (i % BMP_BITS))))
+			return HC_BAD_BIN;
+		if (NULL != pfc && (!_nmIsChunk(ph, pfc, FREE_MASK) || (TREE_BIN(ph, i) && (LINK)0 != TREE(pfc)->t[TCP_PARENT])))
+			return HC_BAD_BIN;
+		for (pfc = _nmBinFirst(ph, i); NULL != pfc; pfc = _nmBinNext(ph, i, pfc))
+		{	/* Links are known to be mutual, so a list can only be longer than nfree by looping wrongly. */
+			if (!_nmIsChunk(ph, pfc, FREE_MASK) ||
+				i != (size_t)(_nmLocateHashTable(ph, _nmBinIndex(ph, HEAD_NOTE(pfc) & ~(size_t)MASK)) - HASH_TABLE(ph)))
+				return HC_BAD_BIN;
+			if (++n > nfree)
+				return HC_BAD_LINK;
+		}
+	}
+	for (i = 0; i < BMP_SIZE(ph->hshsiz); ++i)
+		if ((0 != BIN_BITMAP(ph)[i]) != !!(BIN_SUMMARY(ph) & ((size_t)1 << i)))
+			return HC_BAD_BIN;
+
+	/* Every listed chunk is a distinct free chunk, so equal counts mean every free chunk is listed. */
+	if (n != nfree)
+		return HC_UNLINKED;
+
+	/* The same goes for quick lists, which are linked one way. */
+	n = 0;
+	if (HF_QUICK & ph->flags)
+	{
+		for (i = 0; i < QUICK_BINS; ++i)
+		{
+			for (pfc = L2P(ph, HEAP_QUICK(ph)->bin[i]); NULL != pfc; pfc = L2P(ph, pfc->p[FCP_NEXT]))
+			{
+				if (!_nmIsChunk(ph, pfc, QUICK_MASK) || (i + 1) * ALIGN != (HEAD_NOTE(pfc) & ~(size_t)MASK))
+					return HC_BAD_BIN;
+				if (++n > nquick)
+					return HC_BAD_LINK;
+			}
+		}
+		if (n != HEAP_QUICK(ph)->count)
+			return HC_BAD_BIN;
+	}
+	return n == nquick ? HC_OK : HC_UNLINKED;
+}
+
+/* Function name: nmCheckHeapSlice
+ * Description:   Check a bounded part of the heap and remember where to go on.
+ * Parameters:
+ *         ph Pointer to heap header.
+ *       pcur Pointer to a cursor. Set *pcur to 0 before the first call.
+ *            It moves to the next chunk to check and wraps to 0 after the last chunk.
+ *            On error it holds the offset of the bad chunk from HEAP_BEGIN(ph).
+ *            Chunks of extra segments follow those of the heap itself in this count.
+ *       nchk The most chunks to check in this call. 0 means up to the end of the heap.
+ * Return value:  HC_OK or one of the errors of en_HeapCheck.
+ * Tip:           Each chunk costs O(1) and nothing is allocated, so calls can be spread between
+ *                heap operations. If the heap changed so that *pcur no longer starts a chunk,
+ *                the check starts over from the first chunk.
+ *                HC_UNLINKED here only means that the bin of a free chunk is empty.
+ *                Call nmCheckHeap to prove that every free chunk is reachable.
+ */
+int nmCheckHeapSlice(P_HEAP_HEADER ph, size_t * pcur, size_t nchk)
+{
+	size_t nfree, nquick;
+
+	return _nmCheckRange(ph, pcur, nchk, &nfree, &nquick);
+}
@@ -2,7 +2,7 @@
  * Name:        neomalloc.h
  * Description: Neo malloc core function.
  * Author:      cosh.cage#hotmail.com
- * File ID:     1207250701B1B07250708L00050
+ * File ID:     1207250701B1610260122L00185
  * License:     LGPLv3
  * Copyright (C) 2025 John Cage
  *
@@ -26,25 +26,160 @@
 
 #include <stddef.h>  /* Using type size_t. */
 #include <stdbool.h> /* Boolean type and constants. */
+#include <limits.h>  /* Using macro CHAR_BIT. */
  
 /* Define constant NULL. */
 #ifndef NULL
 #define NULL ((void *)0)
 #endif
 
+/* Heap creation flags. */
+enum en_HeapFlag
+{
+	HF_NONE     = 0x00, /* Power of two bins with first fit. */
+	HF_SLI_MASK = 0x0f, /* Bits that hold log2 of sub-classes per class. */
+	HF_TLSF     = 0x10, /* Two-level segregated fit. */
+	HF_ZEROED   = 0x20, /* Memory given to the heap is zero-filled, such as fresh mmap pages. */
+	HF_GROW     = 0x40, /* Keep room for a region provider and extra segments, see nmSetHeapProvider. */
+	HF_ADDRESS  = 0x80, /* Keep every bin in address order, so the lowest chunk that fits is taken. */
+	HF_PADDED   = 0x100, /* Set by nmCreateHeapEx when chunks are shifted by one word to align them. */
+	HF_OFFSETS  = 0x200, /* Set by nmCreateHeapEx when links are offsets, see NM_OFFSETS. */
+	HF_COMPACT  = 0x400, /* Set by nmCreateHeapEx when tags and links are 32 bits, see NM_COMPACT. */
+	HF_BEST     = 0x800, /* Best fit. The last entrance is a tree ordered by size, see nmCreateHeapEx. */
+	HF_QUICK    = 0x1000 /* Keep small freed blocks in quick lists for reuse, see nmSetHeapQuick. */
+};
+
+/* Split each power of two class into 2^n sub-classes for HF_TLSF heaps. */
+#define HF_SLI(n) ((size_t)(n) & HF_SLI_MASK)
+
+/* Define NM_STATS to keep the counters of HEAP_COUNTERS in every heap header.
+ * Without it the counters cost nothing and read as zero.
+ * All code that shares a heap must be built with the same setting.
+ */
+/* #define NM_STATS */
+
+/* Define NM_OFFSETS to link free chunks by offsets from the heap header instead of by pointers.
+ * Such a heap holds no address of its own, so it can be saved in a file or shared memory
+ * and be mapped again at another address by nmAttachHeap. It costs an add on every link.
+ * All code that shares a heap must be built with the same setting.
+ */
+/* #define NM_OFFSETS */
+
+/* Define NM_COMPACT to keep boundary tags and links in 32 bits on 64-bit systems.
+ * A chunk costs 8 bytes of tags instead of 16, and MIN_CHUNK_SIZE drops to 16 bytes.
+ * In exchange blocks are aligned to 8 bytes, a heap with its segments must lie within 4 GiB
+ * above its header, and one block holds at most 1 GiB. Links are offsets, so NM_OFFSETS follows.
+ * All code that shares a heap must be built with the same setting.
+ */
+/* #define NM_COMPACT */
+
+#if defined(NM_COMPACT) && !defined(NM_OFFSETS)
+#define NM_OFFSETS
+#endif
+
+/* Alignment of every block the heap hands out. Front ends align what they carve to it. */
+#ifdef NM_COMPACT
+#define NM_ALIGN 8
+#else
+#define NM_ALIGN (sizeof(size_t) * CHAR_BIT / 4)
+#endif
+
+/* Heap event counters. */
+typedef struct st_HeapCounters
+{
+	size_t usedsiz; /* Bytes in used blocks. */
+	size_t usedcnt; /* Count of used blocks. */
+	size_t allocs;  /* Count of blocks allocated. */
+	size_t frees;   /* Count of blocks freed. */
+	size_t fails;   /* Count of failed allocations. */
+	size_t splits;  /* Count of chunks split. */
+	size_t merges;  /* Count of chunks merged into a neighbour. */
+	size_t grows;   /* Count of regions taken from the region provider. */
+	size_t purged;  /* Bytes handed to the page purger. */
+	size_t mapped;  /* Bytes of huge blocks mapped on their own. */
+	size_t quick;   /* Count of blocks reused from quick lists. */
+} HEAP_COUNTERS, * P_HEAP_COUNTERS;
+
 /* Heap header structure. */
 typedef struct st_HeapHeader
 {
 	size_t size;
 	size_t hshsiz;
+	size_t flags;
+#ifdef NM_STATS
+	HEAP_COUNTERS cnt;
+#endif
 } HEAP_HEADER, * P_HEAP_HEADER;
 
+#define HS_LENGTHS 16 /* Buckets of the bin length histogram. */
+
+/* Heap statistics structure. */
+typedef struct st_HeapStats
+{
+	HEAP_COUNTERS cnt;     /* Zero unless NM_STATS is defined. */
+	size_t freesiz;        /* Bytes in free chunks. */
+	size_t freecnt;        /* Count of free chunks. */
+	size_t maxfree;        /* Size of the biggest free chunk. */
+	size_t quicksiz;       /* Bytes in chunks held by quick lists. They are not counted as free. */
+	size_t quickcnt;       /* Count of chunks held by quick lists. */
+	size_t lenhist[HS_LENGTHS]; /* lenhist[0]: Empty bins. lenhist[i]: Bins of 2^(i-1) to 2^i - 1 chunks.
+	                             * The last bucket counts longer bins too. */
+	size_t * pbin;         /* Set by caller: NULL or an array of hshsiz elements that receives
+	                        * the count of chunks in each bin. */
+} HEAP_STATS, * P_HEAP_STATS;
+
+/* Results of nmCheckHeap and nmCheckHeapSlice. */
+enum en_HeapCheck
+{
+	HC_OK       =  0, /* No corruption found. */
+	HC_BAD_TAG  = -1, /* Head note and foot note differ, or a chunk runs out of the heap. */
+	HC_ADJ_FREE = -2, /* Two adjacent chunks are both free. */
+	HC_BAD_LINK = -3, /* Links of a free chunk are broken or lead into another bin. */
+	HC_BAD_BIN  = -4, /* A bin entrance disagrees with the bitmap or holds a chunk of another bin. */
+	HC_UNLINKED = -5  /* A free chunk is not reachable from its bin. */
+};
+
+/* Region provider. Return size bytes at pend, the end of the heap, or anywhere else, or NULL. */
+typedef void * (* CBF_REGION)(size_t size, void * pend, void * pparam);
+
+/* Page purger. Give the pages of [p, p + size) back to the system.
+ * Afterwards each byte must read as before or as 0, like private anonymous memory after madvise.
+ */
+typedef void (* CBF_PURGE)(void * p, size_t size, void * pparam);
+
+/* Mapper of huge blocks, used like realloc. p == NULL maps newsiz bytes of zero.
+ * newsiz == 0 unmaps oldsiz bytes at p and returns NULL. Otherwise resize the mapping at p,
+ * moving it if needed. Return NULL on failure and leave the mapping as it was.
+ */
+typedef void * (* CBF_REMAP)(void * p, size_t oldsiz, size_t newsiz, void * pparam);
+
+/* Callback of nmWalkHeap. Return 0 to go on. Any other value stops the walk. */
+typedef int (* CBF_WALK)(void * ptr, size_t size, bool bfree, void * pparam);
+
 /* Exported functions. */
-P_HEAP_HEADER nmCreateHeap  (void *        pbase, size_t size,  size_t hshsiz);
-P_HEAP_HEADER nmExtendHeap  (P_HEAP_HEADER ph,    size_t sizincl);
-void *        nmAllocHeap   (P_HEAP_HEADER ph,    size_t size);
-void          nmFreeHeap    (P_HEAP_HEADER ph,    void * ptr);
-void *        nmReallocHeap (P_HEAP_HEADER ph,    void * ptr,   size_t size);
+P_HEAP_HEADER nmCreateHeap      (void *        pbase, size_t size,      size_t hshsiz);
+P_HEAP_HEADER nmCreateHeapEx    (void *        pbase, size_t size,      size_t hshsiz, size_t flags);
+size_t        nmMeasureHeap     (size_t        size,  size_t hshsiz,    size_t flags);
+P_HEAP_HEADER nmAttachHeap      (void *        pbase, size_t size);
+P_HEAP_HEADER nmExtendHeap      (P_HEAP_HEADER ph,    size_t sizincl);
+P_HEAP_HEADER nmAddHeapSegment  (P_HEAP_HEADER ph,    void * pbase,     size_t size);
+bool          nmSetHeapProvider (P_HEAP_HEADER ph,    CBF_REGION cbf,   void * pparam);
+bool          nmSetHeapPurger   (P_HEAP_HEADER ph,    CBF_PURGE cbf,    size_t page,   size_t thresh);
+size_t        nmTrimHeap        (P_HEAP_HEADER ph,    size_t keep);
+bool          nmSetHeapMapper   (P_HEAP_HEADER ph,    CBF_REMAP cbf,    size_t gran,   size_t thresh);
+bool          nmSetHeapQuick    (P_HEAP_HEADER ph,    size_t limit);
+void *        nmAllocHeap       (P_HEAP_HEADER ph,    size_t size);
+void *        nmCallocHeap      (P_HEAP_HEADER ph,    size_t num,       size_t size);
+void *        nmAllocAlignedHeap(P_HEAP_HEADER ph,    size_t alignment, size_t size);
+size_t        nmAllocBatch      (P_HEAP_HEADER ph,    size_t size,      size_t count,  void * out[]);
+void          nmFreeHeap        (P_HEAP_HEADER ph,    void * ptr);
+void          nmFreeBatch       (P_HEAP_HEADER ph,    void * ptrs[],    size_t count);
+void *        nmReallocHeap     (P_HEAP_HEADER ph,    void * ptr,       size_t size);
+size_t        nmSizeHeap        (void *        ptr);
+void          nmGetHeapStats    (P_HEAP_HEADER ph,    P_HEAP_STATS pst);
+int           nmWalkHeap        (P_HEAP_HEADER ph,    CBF_WALK cbf,     void * pparam);
+int           nmCheckHeap       (P_HEAP_HEADER ph);
+int           nmCheckHeapSlice  (P_HEAP_HEADER ph,    size_t * pcur,    size_t nchk);
  
 #endif
 
@@ -0,0 +1,305 @@
+/*
+ * Name:        nmarena.c
+ * Description: Neo malloc multi-arena heap sets.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262325J1610260115L00305
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nmarena.h"
+#include <string.h>  /* Using function memcpy. */
+
+/* [ARENA SET DIAGRAM]
+ * +==ARENA_SET==+<-------------------- pbase.
+ * | slice       |
+ * | ...         |
+ * | arena[0]    *---\
+ * | arena[1]    *---+---\
+ * | ...         |   |   |
+ * +=============+<--+---+------------- pbegin, aligned to ARENA_ALIGN.
+ * | HEAP_HEADER |<--/   |  slice bytes
+ * | ...         |       |
+ * +-------------+<------/
+ * | HEAP_HEADER |          slice bytes
+ * | ...         |
+ * +=============+<-------------------- pbegin + narena * slice.
+ * The owner of a block is arena[(block - pbegin) / slice].
+ *
+ * +====ARENA====+
+ * | premote     *------> Block --> Block --> NULL.
+ * +=============+        Blocks freed by other arenas. Pushed lock-free, drained all at once
+ *                        by the next allocation of this arena while it holds its lock.
+ *                        Drained blocks go to nmFreeBatch ARENA_DRAIN at a time.
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+
+/* Usable macros. */
+#define ARENA_ALIGN   64 /* Alignment of arena regions. */
+#define AROUND(n)     (((n) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+#define NEXT_LINK(p)  (*(void **)(p))
+#define ARENA_DRAIN   64 /* Count of remote blocks handed to one nmFreeBatch call. */
+
+/* File level function declarations. */
+static void    _nmDrainArena (P_ARENA pa);
+static void *  _nmAllocArena (P_ARENA pa, size_t size);
+static P_ARENA _nmMyArena    (P_ARENA_SET pas);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmDrainArena
+ * Description:   Free every block in the remote queue of an arena. Caller must hold the lock.
+ * Parameter:
+ *         pa Pointer to arena.
+ * Return value:  N/A.
+ */
+static void _nmDrainArena(P_ARENA pa)
+{
+	void * pbat[ARENA_DRAIN];
+	register void * p;
+	register size_t n;
+
+	if (NULL == atomic_load_explicit(&pa->premote, memory_order_relaxed))
+		return;
+
+	/* Take the whole stack in one exchange, so the consumer never races with producers. */
+	p = atomic_exchange_explicit(&pa->premote, NULL, memory_order_acquire);
+	while (NULL != p)
+	{
+		/* Links of a batch are read before any of its blocks is freed. */
+		for (n = 0; NULL != p && n < ARENA_DRAIN; p = NEXT_LINK(p))
+			pbat[n++] = p;
+		nmFreeBatch(pa->ph, pbat, n);
+	}
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmAllocArena
+ * Description:   Allocate from one arena under its lock.
+ * Parameters:
+ *         pa Pointer to arena.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ */
+static void * _nmAllocArena(P_ARENA pa, size_t size)
+{
+	register void * p;
+
+	pthread_mutex_lock(&pa->mtx);
+	_nmDrainArena(pa);
+	p = nmAllocHeap(pa->ph, size);
+	pthread_mutex_unlock(&pa->mtx);
+
+	return p;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMyArena
+ * Description:   Get the arena of the calling thread, assign one round robin on first use.
+ * Parameter:
+ *        pas Pointer to arena set.
+ * Return value:  Pointer to arena.
+ */
+static P_ARENA _nmMyArena(P_ARENA_SET pas)
+{
+	register P_ARENA pa = (P_ARENA)pthread_getspecific(pas->key);
+
+	if (NULL == pa)
+	{
+		pa = &pas->arena[atomic_fetch_add_explicit(&pas->next, 1, memory_order_relaxed) % pas->narena];
+		pthread_setspecific(pas->key, pa);
+	}
+	return pa;
+}
+
+/* Function name: nmCreateArenaSet
+ * Description:   Create a set of independent heaps from a memory buffer.
+ * Parameters:
+ *      pbase Memory buffer starting address.
+ *       size Size of the whole buffer.(Unit in byte)
+ *     narena Count of arenas.
+ *     hshsiz Count of hash table entrances of each heap.
+ * Return value:  NULL: Failed.
+ *                Pointer to arena set(same as pbase): Succeeded.
+ * Tip:           The buffer is split into narena regions of equal size after ARENA_SET.
+ *                Usually narena is the count of cores.
+ */
+P_ARENA_SET nmCreateArenaSet(void * pbase, size_t size, size_t narena, size_t hshsiz)
+{
+	register P_ARENA_SET pas = (P_ARENA_SET)pbase;
+	register size_t i, hdrsiz = AROUND(sizeof(ARENA_SET) + narena * sizeof(ARENA));
+
+	if (NULL == pbase || 0 == narena || size <= hdrsiz)
+		return NULL;
+
+	pas->narena = narena;
+	pas->slice  = (size - hdrsiz) / narena / ARENA_ALIGN * ARENA_ALIGN;
+	pas->pbegin = (PUCHAR)pbase + hdrsiz;
+	atomic_init(&pas->next, 0);
+
+	if (0 != pthread_key_create(&pas->key, NULL))
+		return NULL;
+
+	for (i = 0; i < narena; ++i)
+	{
+		register P_ARENA pa = &pas->arena[i];
+
+		atomic_init(&pa->premote, NULL);
+		pa->ph = nmCreateHeap((PUCHAR)pas->pbegin + i * pas->slice, pas->slice, hshsiz);
+		if (NULL == pa->ph || 0 != pthread_mutex_init(&pa->mtx, NULL))
+		{
+			while (i--)
+				pthread_mutex_destroy(&pas->arena[i].mtx);
+			pthread_key_delete(pas->key);
+			return NULL;
+		}
+	}
+	return pas;
+}
+
+/* Function name: nmDestroyArenaSet
+ * Description:   Release the locks and the thread key of an arena set.
+ * Parameter:
+ *        pas Pointer to arena set.
+ * Return value:  N/A.
+ * Tip:           The buffer may be reused after calling this function.
+ */
+void nmDestroyArenaSet(P_ARENA_SET pas)
+{
+	register size_t i;
+
+	for (i = 0; i < pas->narena; ++i)
+		pthread_mutex_destroy(&pas->arena[i].mtx);
+	pthread_key_delete(pas->key);
+}
+
+/* Function name: nmOwnerArena
+ * Description:   Find the arena that owns a block.
+ * Parameters:
+ *        pas Pointer to arena set.
+ *        ptr Pointer to a block.
+ * Return value:  Pointer to the owner arena or NULL if ptr is out of the set.
+ * Tip:           O(1). Arenas have equal regions, so the owner is found by a division.
+ */
+P_ARENA nmOwnerArena(P_ARENA_SET pas, void * ptr)
+{
+	register size_t off = (size_t)((PUCHAR)ptr - (PUCHAR)pas->pbegin);
+
+	/* Addresses below pbegin wrap around to huge offsets. */
+	if ((PUCHAR)ptr < (PUCHAR)pas->pbegin || off / pas->slice >= pas->narena)
+		return NULL;
+	return &pas->arena[off / pas->slice];
+}
+
+/* Function name: nmAllocArenaSet
+ * Description:   Allocate from the arena of the calling thread.
+ * Parameters:
+ *        pas Pointer to arena set.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ * Tip:           Blocks that other threads freed into this arena are reclaimed here first.
+ *                If the arena is exhausted, the other arenas are tried in turn.
+ */
+void * nmAllocArenaSet(P_ARENA_SET pas, size_t size)
+{
+	register P_ARENA pa = _nmMyArena(pas);
+	register void * p = _nmAllocArena(pa, size);
+	register size_t i;
+
+	for (i = 0; NULL == p && i < pas->narena; ++i)
+		if (&pas->arena[i] != pa)
+			p = _nmAllocArena(&pas->arena[i], size);
+
+	return p;
+}
+
+/* Function name: nmFreeArenaSet
+ * Description:   Free a block into its owner arena.
+ * Parameters:
+ *        pas Pointer to arena set.
+ *        ptr Pointer to a block allocated from this set.
+ * Return value:  N/A.
+ * Tip:           A block owned by another arena is pushed onto its remote queue without locking.
+ */
+void nmFreeArenaSet(P_ARENA_SET pas, void * ptr)
+{
+	register P_ARENA po;
+
+	if (NULL == ptr || NULL == (po = nmOwnerArena(pas, ptr)))
+		return;
+
+	if (po == _nmMyArena(pas))
+	{
+		pthread_mutex_lock(&po->mtx);
+		nmFreeHeap(po->ph, ptr);
+		pthread_mutex_unlock(&po->mtx);
+	}
+	else
+	{	/* Block stays used in the owner heap, so its payload can hold the link. */
+		void * phead = atomic_load_explicit(&po->premote, memory_order_relaxed);
+		do
+			NEXT_LINK(ptr) = phead;
+		while (!atomic_compare_exchange_weak_explicit(&po->premote, &phead, ptr, memory_order_release, memory_order_relaxed));
+	}
+}
+
+/* Function name: nmReallocArenaSet
+ * Description:   Reallocate a block of an arena set.
+ * Parameters:
+ *        pas Pointer to arena set.
+ *        ptr Pointer to a block allocated from this set.
+ *       size New size of memory chunk.
+ * Return value:  NULL: Reallocation failed.
+ *                Pointer to heap memory: Succeeded.
+ * Tip:           A block owned by another arena moves into the arena of the calling thread.
+ *                If that arena is exhausted, the block moves to another arena like nmAllocArenaSet does.
+ */
+void * nmReallocArenaSet(P_ARENA_SET pas, void * ptr, size_t size)
+{
+	register P_ARENA pa;
+	register void * p;
+
+	if (NULL == ptr)
+		return nmAllocArenaSet(pas, size);
+	else if (0 == size)
+	{
+		nmFreeArenaSet(pas, ptr);
+		return NULL;
+	}
+
+	pa = _nmMyArena(pas);
+	if (nmOwnerArena(pas, ptr) == pa)
+	{
+		pthread_mutex_lock(&pa->mtx);
+		p = nmReallocHeap(pa->ph, ptr, size);
+		pthread_mutex_unlock(&pa->mtx);
+		if (NULL != p)
+			return p;
+	}
+
+	/* Move the block, to another arena if this one has no room. */
+	if (NULL != (p = nmAllocArenaSet(pas, size)))
+	{
+		register size_t oldsiz = nmSizeHeap(ptr);
+		memcpy(p, ptr, oldsiz < size ? oldsiz : size);
+		nmFreeArenaSet(pas, ptr);
+	}
+	return p;
+}
@@ -0,0 +1,58 @@
+/*
+ * Name:        nmarena.h
+ * Description: Neo malloc multi-arena heap sets.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262325I1510262330L00058
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMARENA_H_
+#define _NMARENA_H_
+
+#include "neomalloc.h"
+#include <pthread.h>   /* Using type pthread_mutex_t and pthread_key_t. */
+#include <stdatomic.h> /* Using atomic pointers and counters. */
+
+/* Arena structure. */
+typedef struct st_Arena
+{
+	pthread_mutex_t  mtx;     /* Lock of the heap, shared by threads assigned to this arena. */
+	void * _Atomic   premote; /* Lock-free stack of blocks freed by threads of other arenas. */
+	P_HEAP_HEADER    ph;      /* Heap of this arena. */
+} ARENA, * P_ARENA;
+
+/* Arena set structure. */
+typedef struct st_ArenaSet
+{
+	size_t           slice;   /* Size of the region of each arena. */
+	size_t           narena;  /* Count of arenas. */
+	void *           pbegin;  /* Start address of the region of the first arena. */
+	atomic_size_t    next;    /* Round robin counter that assigns threads to arenas. */
+	pthread_key_t    key;     /* Arena of the calling thread. */
+	ARENA            arena[]; /* Arenas. */
+} ARENA_SET, * P_ARENA_SET;
+
+/* Exported functions. */
+P_ARENA_SET nmCreateArenaSet  (void *      pbase, size_t size, size_t narena, size_t hshsiz);
+void        nmDestroyArenaSet (P_ARENA_SET pas);
+P_ARENA     nmOwnerArena      (P_ARENA_SET pas,   void * ptr);
+void *      nmAllocArenaSet   (P_ARENA_SET pas,   size_t size);
+void        nmFreeArenaSet    (P_ARENA_SET pas,   void * ptr);
+void *      nmReallocArenaSet (P_ARENA_SET pas,   void * ptr,  size_t size);
+
+#endif
@@ -0,0 +1,1478 @@
+/*
+ * Name:        nmbench.c
+ * Description: Neo malloc benchmark.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262310D1610260038L01478
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "neomalloc.h"
+#include "nmslab.h"
+#include "nmthread.h"
+#include "nmarena.h"
+#include <stdio.h>   /* Using function printf. */
+#include <stdlib.h>  /* Using function malloc, free, qsort. */
+#include <string.h>  /* Using function memset, strcmp. */
+#include <time.h>    /* Using function timespec_get. */
+#include <unistd.h>  /* Using function sysconf. */
+#include <sched.h>   /* Using function sched_yield. */
+#ifdef __GLIBC__
+#include <malloc.h>  /* Using function mallinfo2 and malloc_trim. */
+#endif
+
+/* Build: cc -O2 -std=c11 -pthread neomalloc.c nmslab.c nmthread.c nmarena.c nmbench.c -o nmbench
+ * Usage: nmbench         Run every benchmark.
+ *        nmbench suite   Run the workload suite only, which compares with the C library.
+ *        nmbench layout  Run the chunk layout benchmark only.
+ *                        Build once more with -DNM_COMPACT and run it again to compare tag layouts.
+ *        nmbench quick   Run the small reuse benchmark only, which compares HF_NONE with HF_QUICK.
+ */
+
+#define BLK_SIZ 48       /* Size of each benchmark block. */
+#define ITERATE 200000   /* Count of timed operations per round. */
+#define LAT_OPS 1000000  /* Count of timed operations for latency histograms. */
+#define LAT_SLT 4096     /* Count of live slots for latency histograms. */
+#define LAT_HEP (1 << 25) /* Heap size for latency histograms. */
+#define EXT_OPS 2000000  /* Count of operations for heap extension. */
+#define EXT_INI (1 << 16) /* Initial heap size for heap extension. */
+#define EXT_INC (1 << 14) /* Step of heap extension. */
+#define SML_HEP (1 << 22) /* Heap size for small objects. */
+#define SML_SIZ 16       /* Size of small objects that fill the heap. */
+#define RLC_OPS 1000000  /* Count of reallocations. */
+#define RLC_BUF 64       /* Count of growing buffers. */
+#define RLC_MAX 65536    /* Buffers start over beyond this size. */
+#define BAT_CNT 4096     /* Count of blocks per batch. */
+#define BAT_RND 200      /* Count of batches. */
+#define CAL_SIZ (1 << 16) /* Size of cleared buffers. */
+#define QCK_OPS 4000000  /* Count of timed operations of the small reuse benchmark. */
+#define QCK_LIV 4096     /* Long-lived blocks that scatter free chunks before it. */
+#define QCK_BST 32       /* Blocks of one handler burst. */
+#define THD_OPS 1000000  /* Count of operations per thread. */
+#define THD_SLT 1024     /* Live slots per thread. */
+#define THD_MAX 64       /* The most threads. */
+#define PIP_OPS 1000000  /* Count of blocks passed from a producer to a consumer. */
+#define PIP_RNG 256      /* Capacity of the ring between a producer and a consumer. */
+#define SUI_OPS 1000000  /* Count of operations of each workload of the suite. */
+#define SUI_SLT 4096     /* Live slots of churning workloads. */
+#define SUI_HEP (1 << 26) /* Heap size of the suite. */
+#define SUI_SMP 4001     /* Operations between two footprint samples. Prime, so it never locks onto a workload. */
+#define SUI_WIN 1024     /* Blocks of one burst of the LIFO and FIFO workloads. */
+#define SUI_MIN 16       /* The smallest size of power law sizes. */
+#define FRG_OPS 4000000  /* Count of operations of the fragmentation workload. */
+#define FRG_LNG 64       /* Long-lived blocks change once per this many operations. */
+#define SUI_CAP (FRG_OPS + 2 * SUI_SLT) /* The most latencies that one workload records. */
+#define LAR_THD 4        /* Threads of the larson workload. */
+#define LAR_RND 8        /* Rounds of the larson workload. */
+#define LAR_OPS 50000    /* Block replacements per thread and round. */
+#define LAR_SLT 1024     /* Blocks that each larson thread holds. */
+#define LAY_HEP (1 << 24) /* Heap size of the layout benchmark. */
+#define LAY_OPS 2000000  /* Count of timed replacements of the layout benchmark. */
+
+/* Function name: _bmNow
+ * Description:   Get current time in nanoseconds since the first call.
+ *                Seconds are rebased so that a double keeps nanosecond precision.
+ * Parameter:     N/A.
+ * Return value:  Time stamp in nanoseconds.
+ */
+static double _bmNow(void)
+{
+	static time_t base = 0;
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	if (0 == base)
+		base = ts.tv_sec;
+	return (double)(ts.tv_sec - base) * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Function name: _bmRand
+ * Description:   Linear congruential generator, so every run is the same.
+ * Parameter:
+ *      pseed Pointer to the seed.
+ * Return value:  Pseudo random number.
+ */
+static size_t _bmRand(size_t * pseed)
+{
+	*pseed = *pseed * 1103515245 + 12345;
+	return (*pseed >> 8) & 0x7fffff;
+}
+
+/* Function name: _bmCompare
+ * Description:   Compare two latencies for qsort.
+ * Parameters:
+ *         px Pointer to a double.
+ *         py Pointer to a double.
+ * Return value:  -1, 0 or 1.
+ */
+static int _bmCompare(const void * px, const void * py)
+{
+	return *(const double *)px < *(const double *)py ? -1 : *(const double *)px > *(const double *)py;
+}
+
+/* Function name: _bmShuffle
+ * Description:   Shuffle an array of pointers with a fixed seed, so every run is the same.
+ * Parameters:
+ *          p Pointer to the array.
+ *          n Count of elements.
+ * Return value:  N/A.
+ */
+static void _bmShuffle(void ** p, size_t n)
+{
+	size_t i, j, seed = 1;
+	void * t;
+	for (i = n; i > 1; --i)
+	{
+		j = _bmRand(&seed) % i;
+		t = p[i - 1];
+		p[i - 1] = p[j];
+		p[j] = t;
+	}
+}
+
+/* Function name: bmBinOccupancy
+ * Description:   Measure free and alloc cost against the length of one bin.
+ *                The heap is fragmented into n free chunks of the same size class
+ *                that are separated by used chunks, so every free chunk sits in one bin.
+ *                Freeing a used chunk then coalesces two neighbours from random places of that bin.
+ * Parameters:
+ *          n Count of free chunks in the bin.
+ *      pfree Receives nanoseconds per coalescing free.
+ *     palloc Receives nanoseconds per alloc/free pair.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmBinOccupancy(size_t n, double * pfree, double * palloc)
+{
+	size_t i, size;
+	void * pbase, ** pblk;
+	P_HEAP_HEADER ph;
+	bool r = false;
+	double t;
+
+	size = (2 * n + 2) * (BLK_SIZ + 2 * sizeof(size_t)) + 64 * sizeof(void *) + 1024;
+	pbase = malloc(size);
+	pblk = (void **)malloc((2 * n + 1) * sizeof(void *));
+	if (NULL == pbase || NULL == pblk)
+	{
+		free(pbase);
+		free(pblk);
+		return false;
+	}
+
+	ph = nmCreateHeap(pbase, size, 64);
+
+	for (i = 0; i < 2 * n + 1; ++i)
+		if (NULL == (pblk[i] = nmAllocHeap(ph, BLK_SIZ)))
+			break;
+
+	if (i == 2 * n + 1)
+	{
+		/* Punch holes. */
+		for (i = 1; i < 2 * n + 1; i += 2)
+			nmFreeHeap(ph, pblk[i]);
+
+		t = _bmNow();
+		for (i = 0; i < ITERATE; ++i)
+			nmFreeHeap(ph, nmAllocHeap(ph, BLK_SIZ));
+		*palloc = (_bmNow() - t) / ITERATE;
+
+		/* Gather used chunks and free them in random order. */
+		for (i = 0; i < n; ++i)
+			pblk[i] = pblk[2 * i + 2];
+		_bmShuffle(pblk, n);
+
+		t = _bmNow();
+		for (i = 0; i < n; ++i)
+			nmFreeHeap(ph, pblk[i]);
+		*pfree = (_bmNow() - t) / n;
+		r = true;
+	}
+
+	free(pblk);
+	free(pbase);
+	return r;
+}
+
+/* Function name: bmLatency
+ * Description:   Random alloc/free churn with per operation timing.
+ *                Sizes are spread inside each power of two class so that first fit has to walk bins.
+ * Parameters:
+ *     hshsiz Count of hash table entrances.
+ *      flags Heap creation flags.
+ *       pres Receives p50, p99, p99.99 and maximum latency in nanoseconds.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmLatency(size_t hshsiz, size_t flags, double pres[4])
+{
+	size_t i, j, seed = 7;
+	void * pbase, * pslt[LAT_SLT] = { NULL };
+	double * plat, t;
+	P_HEAP_HEADER ph;
+
+	pbase = malloc(LAT_HEP);
+	plat = (double *)malloc(LAT_OPS * sizeof(double));
+	if (NULL != pbase) /* Fault pages in up front, so page faults do not pollute the tail. */
+		memset(pbase, 0, LAT_HEP);
+	if (NULL == pbase || NULL == plat || NULL == (ph = nmCreateHeapEx(pbase, LAT_HEP, hshsiz, flags)))
+	{
+		free(pbase);
+		free(plat);
+		return false;
+	}
+
+	for (i = 0; i < LAT_OPS; ++i)
+	{
+		j = _bmRand(&seed) % LAT_SLT;
+		if (NULL != pslt[j])
+		{
+			t = _bmNow();
+			nmFreeHeap(ph, pslt[j]);
+			plat[i] = _bmNow() - t;
+			pslt[j] = NULL;
+		}
+		else
+		{
+			size_t size = 16 + _bmRand(&seed) % (_bmRand(&seed) % 16 ? 1024 : 16384);
+			t = _bmNow();
+			pslt[j] = nmAllocHeap(ph, size);
+			plat[i] = _bmNow() - t;
+		}
+	}
+
+	qsort(plat, LAT_OPS, sizeof(double), _bmCompare);
+	pres[0] = plat[LAT_OPS / 2];
+	pres[1] = plat[LAT_OPS / 100 * 99];
+	pres[2] = plat[LAT_OPS / 10000 * 9999];
+	pres[3] = plat[LAT_OPS - 1];
+
+	free(plat);
+	free(pbase);
+	return true;
+}
+
+/* Function name: bmExtend
+ * Description:   Random alloc/free churn on a heap that starts small and is extended
+ *                by EXT_INC every time an allocation fails, like a heap that grows in production.
+ * Parameters:
+ *      pnext Receives count of extensions.
+ *      pnsop Receives nanoseconds per operation, extensions included.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmExtend(size_t * pnext, double * pnsop)
+{
+	size_t i, j, seed = 11, cap = LAT_HEP;
+	void * pbase, * pslt[LAT_SLT] = { NULL };
+	P_HEAP_HEADER ph;
+	double t;
+
+	pbase = malloc(cap);
+	if (NULL == pbase || NULL == (ph = nmCreateHeap(pbase, EXT_INI, 64)))
+	{
+		free(pbase);
+		return false;
+	}
+
+	*pnext = 0;
+	t = _bmNow();
+	for (i = 0; i < EXT_OPS; ++i)
+	{
+		j = _bmRand(&seed) % LAT_SLT;
+		if (NULL != pslt[j])
+		{
+			nmFreeHeap(ph, pslt[j]);
+			pslt[j] = NULL;
+		}
+		else
+		{
+			size_t size = 16 + _bmRand(&seed) % 1024;
+			while (NULL == (pslt[j] = nmAllocHeap(ph, size)) && EXT_INI + (*pnext + 1) * EXT_INC <= cap)
+			{
+				if (NULL == nmExtendHeap(ph, EXT_INC))
+					break;
+				++*pnext;
+			}
+		}
+	}
+	*pnsop = (_bmNow() - t) / EXT_OPS;
+
+	free(pbase);
+	return true;
+}
+
+/* Function name: bmSmallObjects
+ * Description:   Fill a heap with SML_SIZ byte objects, then churn objects of 8 to SLAB_MAX bytes.
+ * Parameters:
+ *      bslab true: Go through slabs. false: Go through the heap directly.
+ *      pfill Receives count of objects that fit into SML_HEP bytes.
+ *      pnsop Receives nanoseconds per churn operation.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmSmallObjects(bool bslab, size_t * pfill, double * pnsop)
+{
+	size_t i, j, seed = 13, szs[LAT_SLT];
+	void * pbase, * pslt[LAT_SLT] = { NULL };
+	P_HEAP_HEADER ph;
+	P_SLAB_HEADER ps = NULL;
+	double t;
+
+	pbase = malloc(SML_HEP);
+	if (NULL == pbase || NULL == (ph = nmCreateHeap(pbase, SML_HEP, 64)) || (bslab && NULL == (ps = nmCreateSlab(ph))))
+	{
+		free(pbase);
+		return false;
+	}
+
+	for (*pfill = 0; NULL != (bslab ? nmAllocSlab(ps, SML_SIZ) : nmAllocHeap(ph, SML_SIZ)); ++*pfill)
+		;
+
+	/* Start over on a clean heap for the churn. */
+	ph = nmCreateHeap(pbase, SML_HEP, 64);
+	if (bslab)
+		ps = nmCreateSlab(ph);
+
+	t = _bmNow();
+	for (i = 0; i < ITERATE * 10; ++i)
+	{
+		j = _bmRand(&seed) % LAT_SLT;
+		if (NULL != pslt[j])
+		{
+			if (bslab)
+				nmFreeSlab(ps, pslt[j], szs[j]);
+			else
+				nmFreeHeap(ph, pslt[j]);
+			pslt[j] = NULL;
+		}
+		else
+		{
+			szs[j] = 8 + _bmRand(&seed) % (SLAB_MAX - 7);
+			pslt[j] = bslab ? nmAllocSlab(ps, szs[j]) : nmAllocHeap(ph, szs[j]);
+		}
+	}
+	*pnsop = (_bmNow() - t) / (ITERATE * 10);
+
+	free(pbase);
+	return true;
+}
+
+/* Function name: bmLayout
+ * Description:   Fill a heap with objects of one size, then replace random objects one by one.
+ *                Each replacement frees a block between used neighbours and allocates it again.
+ * Parameters:
+ *       size Size of objects in bytes.
+ *      pfill Receives count of objects that fit into LAY_HEP bytes.
+ *      pnsop Receives nanoseconds per replacement.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmLayout(size_t size, size_t * pfill, double * pnsop)
+{
+	size_t i, j, seed = 29;
+	void * pbase, ** pslt;
+	P_HEAP_HEADER ph;
+	double t;
+
+	pbase = malloc(LAY_HEP);
+	pslt = (void **)malloc(LAY_HEP / 8 * sizeof(void *));
+	if (NULL == pbase || NULL == pslt || NULL == (ph = nmCreateHeap(pbase, LAY_HEP, 64)))
+	{
+		free(pbase);
+		free(pslt);
+		return false;
+	}
+
+	for (*pfill = 0; *pfill < LAY_HEP / 8 && NULL != (pslt[*pfill] = nmAllocHeap(ph, size)); ++*pfill)
+		;
+
+	t = _bmNow();
+	for (i = 0; i < LAY_OPS && 0 != *pfill; ++i)
+	{
+		j = _bmRand(&seed) % *pfill;
+		nmFreeHeap(ph, pslt[j]);
+		pslt[j] = nmAllocHeap(ph, size);
+	}
+	*pnsop = (_bmNow() - t) / LAY_OPS;
+
+	free(pbase);
+	free(pslt);
+	return true;
+}
+
+/* Function name: bmRunLayout
+ * Description:   Run the layout benchmark for small object sizes.
+ * Parameter:     N/A.
+ * Return value:  N/A.
+ */
+static void bmRunLayout(void)
+{
+	static const size_t sizes[] = { 8, 16, 24, 32, 48, 64, 128 };
+	size_t i, n;
+	double tf;
+
+#ifdef NM_COMPACT
+	printf("%-24s%12s%12s%12s\n", "layout, 32-bit tags", "objects", "B/object", "ns/op");
+#else
+	printf("%-24s%12s%12s%12s\n", "layout, word tags", "objects", "B/object", "ns/op");
+#endif
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+	{
+		if (bmLayout(sizes[i], &n, &tf) && 0 != n)
+			printf("%-18s%4zu B%12zu%12.1f%12.1f\n", "objects of", sizes[i], n, (double)LAY_HEP / n, tf);
+		else
+			printf("%-18s%4zu B%12s\n", "objects of", sizes[i], "failed");
+	}
+}
+
+/* Function name: bmReallocGrowth
+ * Description:   Grow many buffers in turns, like interleaved string builders, then free them all.
+ * Parameters:
+ *      pmove Receives the count of reallocations that moved the buffer.
+ *      pnsop Receives nanoseconds per reallocation.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmReallocGrowth(size_t * pmove, double * pnsop)
+{
+	P_HEAP_HEADER ph;
+	void * pbase, * pbuf[RLC_BUF] = { NULL };
+	size_t i, j, seed = 11, move = 0, size[RLC_BUF] = { 0 };
+	double t;
+	bool r = true;
+
+	pbase = malloc(LAT_HEP);
+	if (NULL == pbase)
+		return false;
+	memset(pbase, 0, LAT_HEP);
+
+	ph = nmCreateHeap(pbase, LAT_HEP, 64);
+	t = _bmNow();
+	for (i = 0; r && i < RLC_OPS; ++i)
+	{
+		void * p;
+		j = _bmRand(&seed) % RLC_BUF;
+		size[j] += 1 + _bmRand(&seed) % 64;
+		if (size[j] > RLC_MAX)
+		{	/* Start the buffer over. */
+			nmFreeHeap(ph, pbuf[j]);
+			pbuf[j] = NULL;
+			size[j] = 1;
+		}
+		p = nmReallocHeap(ph, pbuf[j], size[j]);
+		if (NULL == p)
+			r = false;
+		else if (NULL != pbuf[j] && p != pbuf[j])
+			++move;
+		pbuf[j] = p;
+	}
+	t = _bmNow() - t;
+
+	for (j = 0; j < RLC_BUF; ++j)
+		nmFreeHeap(ph, pbuf[j]);
+
+	free(pbase);
+	*pmove = move;
+	*pnsop = t / RLC_OPS;
+	return r;
+}
+
+/* Function name: bmBatch
+ * Description:   Allocate batches of same-sized blocks, then free them in random order.
+ * Parameters:
+ *     bbatch true: Use nmAllocBatch and nmFreeBatch. false: Loop over nmAllocHeap and nmFreeHeap.
+ *     palloc Receives nanoseconds per allocated block.
+ *      pfree Receives nanoseconds per freed block.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmBatch(bool bbatch, double * palloc, double * pfree)
+{
+	P_HEAP_HEADER ph;
+	void * pbase, ** pblk;
+	size_t i, j;
+	double t, ta = 0.0, tf = 0.0;
+	bool r = true;
+
+	pbase = malloc(LAT_HEP);
+	pblk = (void **)malloc(sizeof(void *) * BAT_CNT);
+	if (NULL == pbase || NULL == pblk)
+	{
+		free(pbase);
+		free(pblk);
+		return false;
+	}
+	memset(pbase, 0, LAT_HEP);
+
+	ph = nmCreateHeap(pbase, LAT_HEP, 64);
+	for (i = 0; r && i < BAT_RND; ++i)
+	{
+		t = _bmNow();
+		if (bbatch)
+			r = BAT_CNT == nmAllocBatch(ph, BLK_SIZ, BAT_CNT, pblk);
+		else
+			for (j = 0; r && j < BAT_CNT; ++j)
+				r = NULL != (pblk[j] = nmAllocHeap(ph, BLK_SIZ));
+		ta += _bmNow() - t;
+
+		if (!r)
+			break;
+
+		/* Callers rarely free in allocation order. */
+		_bmShuffle(pblk, BAT_CNT);
+
+		t = _bmNow();
+		if (bbatch)
+			nmFreeBatch(ph, pblk, BAT_CNT);
+		else
+			for (j = 0; j < BAT_CNT; ++j)
+				nmFreeHeap(ph, pblk[j]);
+		tf += _bmNow() - t;
+	}
+
+	free(pblk);
+	free(pbase);
+	*palloc = ta / ((double)BAT_CNT * BAT_RND);
+	*pfree = tf / ((double)BAT_CNT * BAT_RND);
+	return r;
+}
+
+/* Function name: bmCalloc
+ * Description:   Fill a fresh zero-filled heap with cleared buffers.
+ * Parameters:
+ *     bzero true: nmCallocHeap on a heap created with HF_ZEROED. false: nmAllocHeap and memset.
+ *     pnsop Receives nanoseconds per buffer.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmCalloc(bool bzero, double * pnsop)
+{
+	P_HEAP_HEADER ph;
+	void * pbase, * p;
+	size_t n = 0;
+	double t;
+
+	/* Fresh pages from calloc are zero, like fresh mmap pages. */
+	pbase = calloc(1, LAT_HEP);
+	if (NULL == pbase)
+		return false;
+	memset(pbase, 0, LAT_HEP); /* Fault pages in, so neither side pays for it. */
+
+	ph = nmCreateHeapEx(pbase, LAT_HEP, 64, bzero ? HF_ZEROED : HF_NONE);
+	t = _bmNow();
+	for (;;)
+	{
+		if (bzero)
+			p = nmCallocHeap(ph, 1, CAL_SIZ);
+		else if (NULL != (p = nmAllocHeap(ph, CAL_SIZ)))
+			memset(p, 0, CAL_SIZ);
+		if (NULL == p)
+			break;
+		++n;
+	}
+	t = _bmNow() - t;
+
+	free(pbase);
+	*pnsop = t / (double)n;
+	return 0 != n;
+}
+
+/* Function name: bmQuick
+ * Description:   Reuse small blocks on a heap with scattered free chunks.
+ * Parameters:
+ *     flags HF_NONE or HF_QUICK.
+ *    bburst true: Allocate QCK_BST blocks of mixed sizes, then free them all, like a request handler.
+ *           false: Allocate and free one block of the same size over and over.
+ *     pnsop Receives nanoseconds per operation.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+static bool bmQuick(size_t flags, bool bburst, double * pnsop)
+{
+	P_HEAP_HEADER ph;
+	void * pbase, * p[QCK_LIV], * pb[QCK_BST];
+	size_t i, j, seed = 1;
+	double t;
+
+	pbase = malloc(LAT_HEP);
+	if (NULL == pbase)
+		return false;
+
+	ph = nmCreateHeapEx(pbase, LAT_HEP, 64, flags);
+	for (i = 0; i < QCK_LIV; ++i)
+		p[i] = nmAllocHeap(ph, 16 + _bmRand(&seed) % 256);
+	for (i = 0; i < QCK_LIV; i += 2)
+		nmFreeHeap(ph, p[i]);
+
+	t = _bmNow();
+	for (i = 0; i < QCK_OPS; i += 2 * QCK_BST)
+	{
+		if (bburst)
+		{
+			for (j = 0; j < QCK_BST; ++j)
+				pb[j] = nmAllocHeap(ph, (size_t)16 << (j % 4));
+			for (j = 0; j < QCK_BST; ++j)
+				nmFreeHeap(ph, pb[j]);
+		}
+		else
+			for (j = 0; j < QCK_BST; ++j)
+				nmFreeHeap(ph, nmAllocHeap(ph, BLK_SIZ));
+	}
+	t = _bmNow() - t;
+
+	free(pbase);
+	*pnsop = t / (double)QCK_OPS;
+	return true;
+}
+
+/* Function name: bmRunQuick
+ * Description:   Run the small reuse benchmark without and with quick lists.
+ * Parameter:     N/A.
+ * Return value:  N/A.
+ */
+static void bmRunQuick(void)
+{
+	double tn, tq;
+
+	printf("%-24s%12s%12s\n", "small reuse (ns/op)", "HF_NONE", "HF_QUICK");
+	if (bmQuick(HF_NONE, false, &tn) && bmQuick(HF_QUICK, false, &tq))
+		printf("%-24s%12.1f%12.1f\n", "same-size ping-pong", tn, tq);
+	if (bmQuick(HF_NONE, true, &tn) && bmQuick(HF_QUICK, true, &tq))
+		printf("%-24s%12.1f%12.1f\n", "handler burst", tn, tq);
+}
+
+/* Thread-safe front ends under benchmark. */
+typedef enum en_BenchMode
+{
+	BM_MUTEX, /* nmAllocHeap behind a global mutex. */
+	BM_SYNC,  /* nmAllocSyncHeap. */
+	BM_ARENA  /* nmAllocArenaSet. */
+} BENCH_MODE;
+
+/* Single producer single consumer ring between two benchmark threads. */
+typedef struct st_BenchPipe
+{
+	void *        ring[PIP_RNG];
+	atomic_size_t head; /* Count of blocks produced. */
+	atomic_size_t tail; /* Count of blocks consumed. */
+} BENCH_PIPE, * P_BENCH_PIPE;
+
+/* Benchmark thread context. */
+typedef struct st_BenchThread
+{
+	BENCH_MODE        mode;
+	P_HEAP_HEADER     ph;   /* Heap behind a global mutex. */
+	pthread_mutex_t * pmtx; /* The global mutex. */
+	P_SYNC_HEAP       psh;  /* Thread-safe heap. */
+	P_ARENA_SET       pas;  /* Arena set. */
+	P_BENCH_PIPE      ppip; /* Pipe of a producer and consumer pair. */
+	size_t            seed;
+} BENCH_THREAD, * P_BENCH_THREAD;
+
+/* Function name: _bmAlloc
+ * Description:   Allocate through the front end under benchmark.
+ * Parameters:
+ *        pbt Pointer to BENCH_THREAD.
+ *       size Size in bytes.
+ * Return value:  Pointer to the block or NULL.
+ */
+static void * _bmAlloc(P_BENCH_THREAD pbt, size_t size)
+{
+	void * p;
+
+	switch (pbt->mode)
+	{
+	case BM_SYNC:
+		return nmAllocSyncHeap(pbt->psh, size);
+	case BM_ARENA:
+		return nmAllocArenaSet(pbt->pas, size);
+	default:
+		pthread_mutex_lock(pbt->pmtx);
+		p = nmAllocHeap(pbt->ph, size);
+		pthread_mutex_unlock(pbt->pmtx);
+		return p;
+	}
+}
+
+/* Function name: _bmFree
+ * Description:   Free through the front end under benchmark.
+ * Parameters:
+ *        pbt Pointer to BENCH_THREAD.
+ *        ptr Pointer to the block.
+ * Return value:  N/A.
+ */
+static void _bmFree(P_BENCH_THREAD pbt, void * ptr)
+{
+	switch (pbt->mode)
+	{
+	case BM_SYNC:
+		nmFreeSyncHeap(pbt->psh, ptr);
+		break;
+	case BM_ARENA:
+		nmFreeArenaSet(pbt->pas, ptr);
+		break;
+	default:
+		pthread_mutex_lock(pbt->pmtx);
+		nmFreeHeap(pbt->ph, ptr);
+		pthread_mutex_unlock(pbt->pmtx);
+	}
+}
+
+/* Function name: _bmThreadChurn
+ * Description:   Thread body. Random alloc/free churn of 16 to 512 bytes.
+ * Parameter:
+ *         pv Pointer to BENCH_THREAD.
+ * Return value:  NULL.
+ */
+static void * _bmThreadChurn(void * pv)
+{
+	P_BENCH_THREAD pbt = (P_BENCH_THREAD)pv;
+	void * pslt[THD_SLT] = { NULL };
+	size_t i, j;
+
+	for (i = 0; i < THD_OPS + THD_SLT; ++i)
+	{
+		/* The tail of the loop frees whatever is left. */
+		j = i < THD_OPS ? _bmRand(&pbt->seed) % THD_SLT : i - THD_OPS;
+		if (NULL != pslt[j])
+		{
+			_bmFree(pbt, pslt[j]);
+			pslt[j] = NULL;
+		}
+		else if (i < THD_OPS)
+			pslt[j] = _bmAlloc(pbt, 16 + _bmRand(&pbt->seed) % 497);
+	}
+	return NULL;
+}
+
+/* Function name: _bmThreadProduce
+ * Description:   Thread body. Allocate blocks of 16 to 128 bytes and pass them to the consumer.
+ * Parameter:
+ *         pv Pointer to BENCH_THREAD.
+ * Return value:  NULL.
+ */
+static void * _bmThreadProduce(void * pv)
+{
+	P_BENCH_THREAD pbt = (P_BENCH_THREAD)pv;
+	P_BENCH_PIPE pp = pbt->ppip;
+	size_t i;
+
+	for (i = 0; i < PIP_OPS; ++i)
+	{
+		void * p = _bmAlloc(pbt, 16 + _bmRand(&pbt->seed) % 113);
+		while (i - atomic_load_explicit(&pp->tail, memory_order_acquire) >= PIP_RNG)
+			sched_yield();
+		pp->ring[i % PIP_RNG] = p;
+		atomic_store_explicit(&pp->head, i + 1, memory_order_release);
+	}
+	return NULL;
+}
+
+/* Function name: _bmThreadConsume
+ * Description:   Thread body. Free every block that the producer passes.
+ * Parameter:
+ *         pv Pointer to BENCH_THREAD.
+ * Return value:  NULL.
+ */
+static void * _bmThreadConsume(void * pv)
+{
+	P_BENCH_THREAD pbt = (P_BENCH_THREAD)pv;
+	P_BENCH_PIPE pp = pbt->ppip;
+	size_t i;
+
+	for (i = 0; i < PIP_OPS; ++i)
+	{
+		void * p;
+		while (atomic_load_explicit(&pp->head, memory_order_acquire) == i)
+			sched_yield();
+		p = pp->ring[i % PIP_RNG];
+		atomic_store_explicit(&pp->tail, i + 1, memory_order_release);
+		_bmFree(pbt, p);
+	}
+	return NULL;
+}
+
+/* Function name: bmThreads
+ * Description:   Run n threads against one heap.
+ * Parameters:
+ *          n Count of threads.
+ *       mode Front end under benchmark.
+ *      bpipe true: Pairs of threads, one allocates and the other frees.
+ *            false: Every thread churns its own blocks.
+ * Return value:  Million operations per second in total. Negative value means failure.
+ */
+static double bmThreads(size_t n, BENCH_MODE mode, bool bpipe)
+{
+	BENCH_THREAD bt[THD_MAX];
+	BENCH_PIPE * ppip = NULL;
+	pthread_t tid[THD_MAX];
+	pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+	void * pbase;
+	size_t i;
+	double t;
+
+	pbase = malloc(LAT_HEP);
+	if (bpipe)
+		ppip = (BENCH_PIPE *)malloc(sizeof(BENCH_PIPE) * (n / 2));
+	if (NULL == pbase || (bpipe && NULL == ppip))
+	{
+		free(pbase);
+		free(ppip);
+		return -1.0;
+	}
+
+	memset(&bt[0], 0, sizeof(BENCH_THREAD));
+	bt[0].mode = mode;
+	bt[0].pmtx = &mtx;
+	switch (mode)
+	{
+	case BM_SYNC:
+		bt[0].psh = nmCreateSyncHeap(pbase, LAT_HEP, 64, HF_NONE);
+		break;
+	case BM_ARENA:
+		bt[0].pas = nmCreateArenaSet(pbase, LAT_HEP, n, 64);
+		break;
+	default:
+		bt[0].ph = nmCreateHeap(pbase, LAT_HEP, 64);
+	}
+
+	/* Copy the shared fields before any thread runs and writes its own seed. */
+	for (i = 1; i < n; ++i)
+		bt[i] = bt[0];
+
+	t = _bmNow();
+	for (i = 0; i < n; ++i)
+	{
+		bt[i].seed = i + 1;
+		if (bpipe)
+		{
+			bt[i].ppip = &ppip[i / 2];
+			if (0 == i % 2)
+			{
+				atomic_init(&bt[i].ppip->head, 0);
+				atomic_init(&bt[i].ppip->tail, 0);
+			}
+		}
+		pthread_create(&tid[i], NULL, bpipe ? (i % 2 ? _bmThreadConsume : _bmThreadProduce) : _bmThreadChurn, &bt[i]);
+	}
+	for (i = 0; i < n; ++i)
+		pthread_join(tid[i], NULL);
+	t = _bmNow() - t;
+
+	if (BM_SYNC == mode)
+		nmDestroySyncHeap(bt[0].psh);
+	else if (BM_ARENA == mode)
+		nmDestroyArenaSet(bt[0].pas);
+	free(ppip);
+	free(pbase);
+	return (double)n * (bpipe ? PIP_OPS : THD_OPS) / t * 1e3;
+}
+
+/* Allocator under the workload suite. */
+typedef struct st_Suite
+{
+	bool          bnm;      /* true: Neo malloc. false: The C library. */
+	P_HEAP_HEADER ph;       /* Heap of single-threaded workloads. */
+	P_ARENA_SET   pas;      /* Arena set of threaded workloads. */
+	float *       plat;     /* Latency of each operation in nanoseconds. */
+	size_t        nlat;     /* Count of latencies. */
+	size_t        live;     /* Bytes asked for by live blocks. */
+	size_t        peaklive; /* The most live bytes. */
+	size_t        peakfoot; /* The most bytes that the allocator spans. */
+	size_t        base;     /* Bytes that the C library spanned before the workload. */
+	size_t        fails;    /* Failed allocations. */
+	double        wall;     /* Wall time of threaded workloads. 0 for others. */
+} SUITE, * P_SUITE;
+
+/* Workload of the suite. */
+typedef void (* BENCH_WORK)(P_SUITE ps, size_t arg);
+
+/* Larson thread context. */
+typedef struct st_SuiteThread
+{
+	P_SUITE       ps;
+	void **       pslt;     /* Blocks that this thread replaces. They were allocated by another thread. */
+	size_t *      szs;      /* Sizes of the blocks. */
+	float *       plat;     /* Latencies of this thread. */
+	size_t        seed;
+} SUITE_THREAD, * P_SUITE_THREAD;
+
+/* Function name: _bmCompareFloat
+ * Description:   Compare two latencies for qsort.
+ * Parameters:
+ *         px Pointer to a float.
+ *         py Pointer to a float.
+ * Return value:  -1, 0 or 1.
+ */
+static int _bmCompareFloat(const void * px, const void * py)
+{
+	return *(const float *)px < *(const float *)py ? -1 : *(const float *)px > *(const float *)py;
+}
+
+/* Function name: _bmLastUsed
+ * Description:   Walk callback. Keep the end of the highest used block.
+ * Parameters:
+ *        ptr Pointer to payload.
+ *       size Usable size.
+ *      bfree Whether the chunk is free.
+ *     pparam Pointer to a size_t that holds the end address.
+ * Return value:  0 to go on.
+ */
+static int _bmLastUsed(void * ptr, size_t size, bool bfree, void * pparam)
+{
+	if (!bfree)
+		*(size_t *)pparam = (size_t)ptr + size;
+	return 0;
+}
+
+/* Function name: _bmSuiteFoot
+ * Description:   Get the bytes that an allocator spans.
+ *                For Neo malloc it is the end of the highest used block in each heap.
+ *                For the C library it is what it took from the system since the workload began.
+ * Parameter:
+ *         ps Pointer to SUITE.
+ * Return value:  Bytes.
+ */
+static size_t _bmSuiteFoot(P_SUITE ps)
+{
+	size_t i, end, foot = 0;
+
+	if (!ps->bnm)
+	{
+#if defined __GLIBC__ && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+		struct mallinfo2 mi = mallinfo2();
+		foot = mi.arena + mi.hblkhd;
+#endif
+		return foot > ps->base ? foot - ps->base : 0;
+	}
+
+	for (i = 0; i < (NULL != ps->pas ? ps->pas->narena : 1); ++i)
+	{
+		P_HEAP_HEADER ph = NULL != ps->pas ? ps->pas->arena[i].ph : ps->ph;
+		end = 0;
+		nmWalkHeap(ph, _bmLastUsed, &end);
+		if (0 != end)
+			foot += end - (size_t)ph;
+	}
+	return foot;
+}
+
+/* Function name: _bmSuiteSample
+ * Description:   Sample the footprint every SUI_SMP operations. It is not timed.
+ * Parameter:
+ *         ps Pointer to SUITE.
+ * Return value:  N/A.
+ */
+static void _bmSuiteSample(P_SUITE ps)
+{
+	size_t foot;
+
+	if (0 != ps->nlat % SUI_SMP)
+		return;
+	if ((foot = _bmSuiteFoot(ps)) > ps->peakfoot)
+		ps->peakfoot = foot;
+}
+
+/* Function name: _bmSuiteAlloc
+ * Description:   Timed allocation of a single-threaded workload.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *       size Size in bytes.
+ * Return value:  Pointer to the block or NULL.
+ */
+static void * _bmSuiteAlloc(P_SUITE ps, size_t size)
+{
+	void * p;
+	double t = _bmNow();
+
+	p = ps->bnm ? nmAllocHeap(ps->ph, size) : malloc(size);
+	ps->plat[ps->nlat++] = (float)(_bmNow() - t);
+
+	if (NULL == p)
+		++ps->fails;
+	else if ((ps->live += size) > ps->peaklive)
+		ps->peaklive = ps->live;
+	_bmSuiteSample(ps);
+	return p;
+}
+
+/* Function name: _bmSuiteFree
+ * Description:   Timed freedom of a single-threaded workload.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *        ptr Pointer to the block. NULL is not counted.
+ *       size Size that was asked for.
+ * Return value:  N/A.
+ */
+static void _bmSuiteFree(P_SUITE ps, void * ptr, size_t size)
+{
+	double t;
+
+	if (NULL == ptr)
+		return;
+
+	t = _bmNow();
+	if (ps->bnm)
+		nmFreeHeap(ps->ph, ptr);
+	else
+		free(ptr);
+	ps->plat[ps->nlat++] = (float)(_bmNow() - t);
+
+	ps->live -= size;
+	_bmSuiteSample(ps);
+}
+
+/* Function name: _bmSuiteRealloc
+ * Description:   Timed reallocation of a single-threaded workload.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *        ptr Pointer to the block or NULL.
+ *     oldsiz Size that was asked for before.
+ *       size New size.
+ * Return value:  Pointer to the block or NULL.
+ */
+static void * _bmSuiteRealloc(P_SUITE ps, void * ptr, size_t oldsiz, size_t size)
+{
+	void * p;
+	double t = _bmNow();
+
+	p = ps->bnm ? nmReallocHeap(ps->ph, ptr, size) : realloc(ptr, size);
+	ps->plat[ps->nlat++] = (float)(_bmNow() - t);
+
+	if (NULL == p)
+		++ps->fails;
+	else if ((ps->live += size - oldsiz) > ps->peaklive)
+		ps->peaklive = ps->live;
+	_bmSuiteSample(ps);
+	return p;
+}
+
+/* Function name: _bmSizeUniform
+ * Description:   Uniform random size of 16 to 1024 bytes.
+ * Parameter:
+ *      pseed Pointer to the seed.
+ * Return value:  Size in bytes.
+ */
+static size_t _bmSizeUniform(size_t * pseed)
+{
+	return 16 + _bmRand(pseed) % 1009;
+}
+
+/* Function name: _bmSizePower
+ * Description:   Power law random size. Class k of SUI_MIN << k to twice that is taken with
+ *                probability 2^-(k+1), so the density falls with the square of the size.
+ * Parameter:
+ *      pseed Pointer to the seed.
+ * Return value:  Size in bytes, at most SUI_MIN << 13.
+ */
+static size_t _bmSizePower(size_t * pseed)
+{
+	size_t r = _bmRand(pseed), k = 0;
+
+	while (k < 12 && (r >> k & 1))
+		++k;
+	return (SUI_MIN << k) + _bmRand(pseed) % (SUI_MIN << k);
+}
+
+/* Function name: _bmWorkChurn
+ * Description:   Workload. Random slots are freed or allocated.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *     bpower 0: Uniform sizes. Otherwise: Power law sizes.
+ * Return value:  N/A.
+ */
+static void _bmWorkChurn(P_SUITE ps, size_t bpower)
+{
+	void * pslt[SUI_SLT] = { NULL };
+	size_t i, j, seed = 17, szs[SUI_SLT];
+
+	for (i = 0; i < SUI_OPS; ++i)
+	{
+		j = _bmRand(&seed) % SUI_SLT;
+		if (NULL != pslt[j])
+		{
+			_bmSuiteFree(ps, pslt[j], szs[j]);
+			pslt[j] = NULL;
+		}
+		else
+		{
+			szs[j] = bpower ? _bmSizePower(&seed) : _bmSizeUniform(&seed);
+			pslt[j] = _bmSuiteAlloc(ps, szs[j]);
+		}
+	}
+	for (j = 0; j < SUI_SLT; ++j)
+		_bmSuiteFree(ps, pslt[j], szs[j]);
+}
+
+/* Function name: _bmWorkOrder
+ * Description:   Workload. Bursts of SUI_WIN blocks are allocated, then freed all.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *      bfifo 0: Free in reverse order of allocation. Otherwise: Free in order of allocation.
+ * Return value:  N/A.
+ */
+static void _bmWorkOrder(P_SUITE ps, size_t bfifo)
+{
+	void * pwin[SUI_WIN];
+	size_t i, j, k, seed = 19, szs[SUI_WIN];
+
+	for (i = 0; i < SUI_OPS; i += 2 * SUI_WIN)
+	{
+		for (j = 0; j < SUI_WIN; ++j)
+		{
+			szs[j] = _bmSizeUniform(&seed);
+			pwin[j] = _bmSuiteAlloc(ps, szs[j]);
+		}
+		for (j = 0; j < SUI_WIN; ++j)
+		{
+			k = bfifo ? j : SUI_WIN - 1 - j;
+			_bmSuiteFree(ps, pwin[k], szs[k]);
+		}
+	}
+}
+
+/* Function name: _bmWorkRealloc
+ * Description:   Workload. Buffers grow in turns, like interleaved string builders.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *        arg Unused.
+ * Return value:  N/A.
+ */
+static void _bmWorkRealloc(P_SUITE ps, size_t arg)
+{
+	void * pbuf[RLC_BUF] = { NULL };
+	size_t i, j, seed = 23, t, size[RLC_BUF] = { 0 };
+
+	(void)arg;
+	for (i = 0; i < SUI_OPS; ++i)
+	{
+		void * p;
+		j = _bmRand(&seed) % RLC_BUF;
+		t = size[j] + 1 + _bmRand(&seed) % 64;
+		if (t > RLC_MAX)
+		{	/* Start the buffer over. */
+			_bmSuiteFree(ps, pbuf[j], size[j]);
+			pbuf[j] = NULL;
+			size[j] = 0;
+			t = 1;
+		}
+		if (NULL != (p = _bmSuiteRealloc(ps, pbuf[j], size[j], t)))
+		{
+			pbuf[j] = p;
+			size[j] = t;
+		}
+	}
+	for (j = 0; j < RLC_BUF; ++j)
+		_bmSuiteFree(ps, pbuf[j], size[j]);
+}
+
+/* Function name: _bmWorkFragment
+ * Description:   Workload. Power law churn runs long among small blocks that live much longer,
+ *                so that long-lived blocks pin free space apart.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *        arg Unused.
+ * Return value:  N/A.
+ */
+static void _bmWorkFragment(P_SUITE ps, size_t arg)
+{
+	void * pshort[SUI_SLT] = { NULL }, * plong[SUI_SLT] = { NULL };
+	size_t i, j, seed = 29, szs[SUI_SLT], szl[SUI_SLT];
+
+	(void)arg;
+	for (i = 0; i < FRG_OPS; ++i)
+	{
+		bool blong = 0 == i % FRG_LNG;
+		void ** pslt = blong ? plong : pshort;
+		size_t * psz = blong ? szl : szs;
+
+		j = _bmRand(&seed) % SUI_SLT;
+		if (NULL != pslt[j])
+		{
+			_bmSuiteFree(ps, pslt[j], psz[j]);
+			pslt[j] = NULL;
+		}
+		else
+		{
+			psz[j] = blong ? 16 + _bmRand(&seed) % 113 : _bmSizePower(&seed);
+			pslt[j] = _bmSuiteAlloc(ps, psz[j]);
+		}
+	}
+	for (j = 0; j < SUI_SLT; ++j)
+	{
+		_bmSuiteFree(ps, pshort[j], szs[j]);
+		_bmSuiteFree(ps, plong[j], szl[j]);
+	}
+}
+
+/* Function name: _bmThreadLarson
+ * Description:   Thread body. Replace random blocks, most of which another thread allocated.
+ * Parameter:
+ *         pv Pointer to SUITE_THREAD.
+ * Return value:  NULL.
+ */
+static void * _bmThreadLarson(void * pv)
+{
+	P_SUITE_THREAD pst = (P_SUITE_THREAD)pv;
+	P_SUITE ps = pst->ps;
+	size_t i, j;
+	double t;
+
+	for (i = 0; i < LAR_OPS; ++i)
+	{
+		j = _bmRand(&pst->seed) % LAR_SLT;
+
+		t = _bmNow();
+		if (ps->bnm)
+			nmFreeArenaSet(ps->pas, pst->pslt[j]);
+		else
+			free(pst->pslt[j]);
+		pst->plat[2 * i] = (float)(_bmNow() - t);
+
+		pst->szs[j] = 16 + _bmRand(&pst->seed) % 497;
+		t = _bmNow();
+		pst->pslt[j] = ps->bnm ? nmAllocArenaSet(ps->pas, pst->szs[j]) : malloc(pst->szs[j]);
+		pst->plat[2 * i + 1] = (float)(_bmNow() - t);
+	}
+	return NULL;
+}
+
+/* Function name: _bmWorkLarson
+ * Description:   Workload. Like the larson server benchmark, each round starts fresh threads
+ *                and hands every thread the blocks of another thread of the round before,
+ *                so most frees are cross-thread.
+ * Parameters:
+ *         ps Pointer to SUITE.
+ *        arg Unused. There are always LAR_THD threads.
+ * Return value:  N/A.
+ */
+static void _bmWorkLarson(P_SUITE ps, size_t arg)
+{
+	SUITE_THREAD st[LAR_THD];
+	pthread_t tid[LAR_THD];
+	void ** pslt;
+	size_t * szs;
+	size_t i, j, r, seed = 31;
+	double t;
+
+	(void)arg;
+	pslt = (void **)calloc(LAR_THD * LAR_SLT, sizeof(void *));
+	szs = (size_t *)calloc(LAR_THD * LAR_SLT, sizeof(size_t));
+	if (NULL == pslt || NULL == szs)
+	{
+		free(pslt);
+		free(szs);
+		++ps->fails;
+		return;
+	}
+
+	for (r = 0; r < LAR_RND; ++r)
+	{
+		t = _bmNow();
+		for (i = 0; i < LAR_THD; ++i)
+		{
+			j = (i + r) % LAR_THD; /* The block set moves to the next thread every round. */
+			st[i].ps = ps;
+			st[i].pslt = &pslt[j * LAR_SLT];
+			st[i].szs = &szs[j * LAR_SLT];
+			st[i].plat = &ps->plat[ps->nlat + i * 2 * LAR_OPS];
+			st[i].seed = seed + r * LAR_THD + i;
+			pthread_create(&tid[i], NULL, _bmThreadLarson, &st[i]);
+		}
+		for (i = 0; i < LAR_THD; ++i)
+			pthread_join(tid[i], NULL);
+		ps->wall += _bmNow() - t;
+		ps->nlat += LAR_THD * 2 * LAR_OPS;
+
+		for (ps->live = 0, j = 0; j < LAR_THD * LAR_SLT; ++j)
+			if (NULL != pslt[j])
+				ps->live += szs[j];
+			else if (0 != szs[j])
+				++ps->fails;
+		if (ps->live > ps->peaklive)
+			ps->peaklive = ps->live;
+		if ((t = (double)_bmSuiteFoot(ps)) > (double)ps->peakfoot)
+			ps->peakfoot = (size_t)t;
+	}
+
+	for (j = 0; j < LAR_THD * LAR_SLT; ++j)
+		if (ps->bnm)
+			nmFreeArenaSet(ps->pas, pslt[j]);
+		else
+			free(pslt[j]);
+	free(pslt);
+	free(szs);
+}
+
+/* Function name: bmSuite
+ * Description:   Run one workload against Neo malloc and the C library and print a row for each.
+ *                Rows show throughput, latency percentiles, the most bytes asked for at a time
+ *                and the footprint against SUI_HEP, the size of the Neo malloc heap.
+ * Parameters:
+ *       name Name of the workload.
+ *       work Workload.
+ *        arg Argument of the workload.
+ *    bthread true: The workload runs threads, so Neo malloc serves it with an arena set.
+ * Return value:  N/A.
+ * Tip:           Throughput of single-threaded workloads sums the timed calls only.
+ *                The Neo malloc heap is faulted in up front, like a region given by the application.
+ */
+static void bmSuite(const char * name, BENCH_WORK work, size_t arg, bool bthread)
+{
+	SUITE su;
+	void * pbase;
+	size_t k;
+	double sum;
+
+	for (k = 0; k < 2; ++k)
+	{
+		memset(&su, 0, sizeof(SUITE));
+		su.bnm = 0 == k;
+		pbase = NULL;
+		su.plat = (float *)malloc(SUI_CAP * sizeof(float));
+		if (su.bnm)
+		{
+			if (NULL != (pbase = malloc(SUI_HEP)))
+			{
+				memset(pbase, 0, SUI_HEP);
+				if (bthread)
+					su.pas = nmCreateArenaSet(pbase, SUI_HEP, LAR_THD, 64);
+				else
+					su.ph = nmCreateHeap(pbase, SUI_HEP, 64);
+			}
+		}
+		else
+		{
+#ifdef __GLIBC__
+			malloc_trim(0);
+#endif
+			su.base = _bmSuiteFoot(&su);
+		}
+
+		if (NULL == su.plat || (su.bnm && NULL == su.ph && NULL == su.pas))
+			printf("%-24s%-10s%10s\n", name, su.bnm ? "neomalloc" : "libc", "failed");
+		else
+		{
+			work(&su, arg);
+
+			for (sum = 0.0, k = 0; k < su.nlat; ++k)
+				sum += su.plat[k];
+			k = 0 == su.bnm;
+			qsort(su.plat, su.nlat, sizeof(float), _bmCompareFloat);
+			printf("%-24s%-10s%10.2f%10.0f%10.0f%10.0f%12zu%12zu%8.1f%%%8zu\n", name, su.bnm ? "neomalloc" : "libc",
+				su.nlat / (0.0 != su.wall ? su.wall : sum) * 1e3,
+				su.plat[su.nlat / 2], su.plat[su.nlat / 100 * 99], su.plat[su.nlat / 1000 * 999],
+				su.peaklive / 1024, su.peakfoot / 1024, 100.0 * su.peakfoot / SUI_HEP, su.fails);
+		}
+
+		if (NULL != su.pas)
+			nmDestroyArenaSet(su.pas);
+		free(pbase);
+		free(su.plat);
+	}
+}
+
+/* Function name: bmRunSuite
+ * Description:   Run every workload of the suite.
+ * Parameter:     N/A.
+ * Return value:  N/A.
+ */
+static void bmRunSuite(void)
+{
+	printf("%-24s%-10s%10s%10s%10s%10s%12s%12s%9s%8s\n", "workload", "allocator", "Mops/s",
+		"p50 ns", "p99 ns", "p99.9 ns", "live KiB", "foot KiB", "of heap", "fails");
+	bmSuite("uniform 16-1024B", _bmWorkChurn, 0, false);
+	bmSuite("power law 16B-128KiB", _bmWorkChurn, 1, false);
+	bmSuite("LIFO bursts", _bmWorkOrder, 0, false);
+	bmSuite("FIFO bursts", _bmWorkOrder, 1, false);
+	bmSuite("realloc growth", _bmWorkRealloc, 0, false);
+	bmSuite("long fragmentation", _bmWorkFragment, 0, false);
+	bmSuite("larson, 4 threads", _bmWorkLarson, 0, true);
+}
+
+int main(int argc, char ** argv)
+{
+	size_t n;
+	double tf, ta, lat[4];
+
+	if (argc > 1 && 0 == strcmp(argv[1], "suite"))
+	{
+		bmRunSuite();
+		return 0;
+	}
+	if (argc > 1 && 0 == strcmp(argv[1], "layout"))
+	{
+		bmRunLayout();
+		return 0;
+	}
+	if (argc > 1 && 0 == strcmp(argv[1], "quick"))
+	{
+		bmRunQuick();
+		return 0;
+	}
+
+	printf("%-24s%12s%16s%16s\n", "scenario", "free chunks", "ns/free", "ns/alloc+free");
+	for (n = 64; n <= 65536; n <<= 2)
+	{
+		if (bmBinOccupancy(n, &tf, &ta))
+			printf("%-24s%12zu%16.1f%16.1f\n", "bin occupancy", n, tf, ta);
+		else
+			printf("%-24s%12zu%16s%16s\n", "bin occupancy", n, "failed", "failed");
+	}
+
+	printf("\n%-24s%12s%12s%12s%12s\n", "latency (ns)", "p50", "p99", "p99.99", "max");
+	if (bmLatency(64, HF_NONE, lat))
+		printf("%-24s%12.0f%12.0f%12.0f%12.0f\n", "power of two", lat[0], lat[1], lat[2], lat[3]);
+	if (bmLatency(512, HF_TLSF | HF_SLI(4), lat))
+		printf("%-24s%12.0f%12.0f%12.0f%12.0f\n", "tlsf, 16 sub-classes", lat[0], lat[1], lat[2], lat[3]);
+
+	printf("\n%-24s%12s%12s\n", "scenario", "extensions", "ns/op");
+	if (bmExtend(&n, &tf))
+		printf("%-24s%12zu%12.1f\n", "extend under load", n, tf);
+
+	printf("\n%-24s%12s%12s\n", "small objects", "16B in 4MiB", "ns/op");
+	if (bmSmallObjects(false, &n, &tf))
+		printf("%-24s%12zu%12.1f\n", "heap", n, tf);
+	if (bmSmallObjects(true, &n, &tf))
+		printf("%-24s%12zu%12.1f\n", "slab", n, tf);
+
+	printf("\n%-24s%12s%12s\n", "realloc", "moves", "ns/op");
+	if (bmReallocGrowth(&n, &tf))
+		printf("%-24s%12zu%12.1f\n", "interleaved growth", n, tf);
+
+	printf("\n%-24s%12s%12s\n", "batch of 4096 x 48B", "ns/alloc", "ns/free");
+	if (bmBatch(false, &ta, &tf))
+		printf("%-24s%12.1f%12.1f\n", "single calls", ta, tf);
+	if (bmBatch(true, &ta, &tf))
+		printf("%-24s%12.1f%12.1f\n", "nmAllocBatch/FreeBatch", ta, tf);
+
+	printf("\n%-24s%12s\n", "cleared 64KiB buffers", "ns/buffer");
+	if (bmCalloc(false, &tf))
+		printf("%-24s%12.1f\n", "alloc + memset", tf);
+	if (bmCalloc(true, &tf))
+		printf("%-24s%12.1f\n", "calloc, HF_ZEROED", tf);
+
+	printf("\n");
+	bmRunQuick();
+
+	printf("\n%-24s%12s%12s%12s%12s\n", "threads (Mops/s)", "threads", "mutex", "sync heap", "arena set");
+	for (n = 1; n <= THD_MAX && n <= (size_t)sysconf(_SC_NPROCESSORS_ONLN); n <<= 1)
+		printf("%-24s%12zu%12.2f%12.2f%12.2f\n", "churn 16-512B", n,
+			bmThreads(n, BM_MUTEX, false), bmThreads(n, BM_SYNC, false), bmThreads(n, BM_ARENA, false));
+	for (n = 2; n <= THD_MAX && n <= (size_t)sysconf(_SC_NPROCESSORS_ONLN) * 2; n <<= 1)
+		printf("%-24s%12zu%12.2f%12.2f%12.2f\n", "producer/consumer", n,
+			bmThreads(n, BM_MUTEX, true), bmThreads(n, BM_SYNC, true), bmThreads(n, BM_ARENA, true));
+
+	printf("\n");
+	bmRunLayout();
+
+	printf("\n");
+	bmRunSuite();
+
+	return 0;
+}
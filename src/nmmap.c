@@ -0,0 +1,143 @@
+/*
+ * Name:        nmmap.c
+ * Description: Neo malloc region provider and page purger on POSIX systems.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1610260000O1610260004L00143
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* These functions fit nmSetHeapProvider and nmSetHeapPurger of a HF_GROW heap:
+ *     pbase = nmMapRegion(size, NULL, NULL);
+ *     ph = nmCreateHeapEx(pbase, size, hshsiz, HF_GROW | HF_ZEROED);
+ *     nmSetHeapProvider(ph, nmMapRegion, NULL);
+ *     nmSetHeapPurger(ph, nmPurgePages, nmPageSize(), thresh);
+ *     nmSetHeapMapper(ph, nmRemapPages, nmPageSize(), thresh);
+ * Mapped pages are zero, so HF_ZEROED holds, and purged pages read as zero or as before.
+ */
+
+#define _GNU_SOURCE     /* Using macro MAP_ANONYMOUS and function madvise and mremap. */
+#include "nmmap.h"
+#include <string.h>     /* Using function memcpy. */
+#include <sys/mman.h>   /* Using function mmap, munmap, mremap and madvise. */
+#include <unistd.h>     /* Using function sysconf. */
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* Function name: nmPageSize
+ * Description:   Get the page size of the system.
+ * Parameter:     N/A.
+ * Return value:  Page size in bytes.
+ */
+size_t nmPageSize(void)
+{
+	long r = sysconf(_SC_PAGESIZE);
+
+	return r > 0 ? (size_t)r : 4096;
+}
+
+/* Function name: nmMapRegion
+ * Description:   Region provider. Map private anonymous pages.
+ * Parameters:
+ *       size Size of the region.
+ *       pend End of the heap. The pages are asked for there first. It can be NULL.
+ *     pparam Not used.
+ * Return value:  NULL: Failed.
+ *                Pointer to the region: Succeeded. It may lie anywhere if pend was taken.
+ * Tip:           The system rounds size up to whole pages. The heap uses size bytes only.
+ */
+void * nmMapRegion(size_t size, void * pend, void * pparam)
+{
+	void * p = mmap(pend, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	(void)pparam;
+	return MAP_FAILED == p ? NULL : p;
+}
+
+/* Function name: nmRemapPages
+ * Description:   Mapper of huge blocks.
+ * Parameters:
+ *          p Pointer to a mapping or NULL.
+ *     oldsiz Size of the mapping at p.
+ *     newsiz New size. 0 unmaps p.
+ *     pparam Not used.
+ * Return value:  NULL: Unmapped or failed.
+ *                Pointer to the mapping: Succeeded.
+ * Tip:           With mremap, pages move without being copied.
+ *                Elsewhere a new mapping is made and the bytes are copied.
+ */
+void * nmRemapPages(void * p, size_t oldsiz, size_t newsiz, void * pparam)
+{
+	void * r;
+
+	(void)pparam;
+	if (0 == newsiz)
+	{
+		munmap(p, oldsiz);
+		return NULL;
+	}
+	if (NULL == p)
+		return nmMapRegion(newsiz, NULL, NULL);
+
+#ifdef MREMAP_MAYMOVE
+	r = mremap(p, oldsiz, newsiz, MREMAP_MAYMOVE);
+	return MAP_FAILED == r ? NULL : r;
+#else
+	if (NULL != (r = nmMapRegion(newsiz, NULL, NULL)))
+	{
+		memcpy(r, p, oldsiz < newsiz ? oldsiz : newsiz);
+		munmap(p, oldsiz);
+	}
+	return r;
+#endif
+}
+
+/* Function name: nmPurgePages
+ * Description:   Page purger. The pages are dropped at once and read as zero afterwards.
+ * Parameters:
+ *          p Pointer to the first page.
+ *       size Size of the pages.
+ *     pparam Not used.
+ * Return value:  N/A.
+ */
+void nmPurgePages(void * p, size_t size, void * pparam)
+{
+	(void)pparam;
+	madvise(p, size, MADV_DONTNEED);
+}
+
+/* Function name: nmPurgePagesLazy
+ * Description:   Page purger. The system takes the pages when it runs short of memory.
+ * Parameters:
+ *          p Pointer to the first page.
+ *       size Size of the pages.
+ *     pparam Not used.
+ * Return value:  N/A.
+ * Tip:           It is cheaper than nmPurgePages, but the resident size drops only under pressure.
+ *                Systems without MADV_FREE drop the pages at once.
+ */
+void nmPurgePagesLazy(void * p, size_t size, void * pparam)
+{
+	(void)pparam;
+#ifdef MADV_FREE
+	madvise(p, size, MADV_FREE);
+#else
+	madvise(p, size, MADV_DONTNEED);
+#endif
+}
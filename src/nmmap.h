@@ -0,0 +1,36 @@
+/*
+ * Name:        nmmap.h
+ * Description: Neo malloc region provider and page purger on POSIX systems.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1610260000N1610260004L00036
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMMAP_H_
+#define _NMMAP_H_
+
+#include "neomalloc.h"
+
+/* Exported functions. */
+size_t nmPageSize       (void);
+void * nmMapRegion      (size_t size, void * pend,   void * pparam);
+void * nmRemapPages     (void * p,    size_t oldsiz, size_t newsiz, void * pparam);
+void   nmPurgePages     (void * p,    size_t size,   void * pparam);
+void   nmPurgePagesLazy (void * p,    size_t size,   void * pparam);
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * Name:        nmreplay.c
+ * Description: Neo malloc trace replay driver.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262345M1610260122L00231
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Build: cc -O2 -std=c11 neomalloc.c nmtrace.c nmreplay.c -o nmreplay
+ * Usage: nmreplay trace [size [hshsiz [flags]]]
+ *            Replay a trace. Heap parameters that are left out or 0 are taken from the trace.
+ *        nmreplay -p trace [size [hshsiz]]
+ *            Replay a trace under each placement policy and compare footprint and fragmentation.
+ *        nmreplay -g trace [ops]
+ *            Record a synthetic workload into a trace, which is handy to try the tool.
+ */
+
+#include "nmtrace.h"
+#include <stdio.h>   /* Using function printf. */
+#include <stdlib.h>  /* Using function malloc, free, strtoul. */
+#include <string.h>  /* Using function strcmp. */
+
+#define GEN_OPS 1000000   /* Default count of synthetic operations. */
+#define GEN_SLT 4096      /* Live slots of the synthetic workload. */
+#define GEN_HEP (1 << 24) /* Heap size of the synthetic workload. */
+
+/* Placement policies compared by -p. */
+static const struct
+{
+	const char * name;
+	size_t       flags;
+} rpPolicy[] =
+{
+	{ "first fit",         HF_NONE },
+	{ "address-ordered",   HF_ADDRESS },
+	{ "best fit",          HF_BEST },
+	{ "address best fit",  HF_ADDRESS | HF_BEST }
+};
+
+/* Function name: _rpRand
+ * Description:   Linear congruential generator, so every run is the same.
+ * Parameter:
+ *      pseed Pointer to the seed.
+ * Return value:  Pseudo random number.
+ */
+static size_t _rpRand(size_t * pseed)
+{
+	*pseed = *pseed * 1103515245 + 12345;
+	return (*pseed >> 8) & 0x7fffff;
+}
+
+/* Function name: rpGenerate
+ * Description:   Record a mix of small and big allocations, frees and reallocations.
+ * Parameters:
+ *       path Name of the trace file.
+ *        ops Count of operations.
+ * Return value:  0: Succeeded. 1: Failed.
+ */
+static int rpGenerate(const char * path, size_t ops)
+{
+	void * pslt[GEN_SLT] = { NULL };
+	size_t i, j, seed = 1;
+	P_HEAP_HEADER ph;
+	void * pbase;
+	TRACE tr;
+
+	if (NULL == (pbase = malloc(GEN_HEP)))
+		return 1;
+	if (NULL == (ph = nmCreateHeap(pbase, GEN_HEP, 64)) || !nmOpenTrace(&tr, ph, path))
+	{
+		free(pbase);
+		return 1;
+	}
+
+	for (i = 0; i < ops; ++i)
+	{
+		j = _rpRand(&seed) % GEN_SLT;
+		if (NULL == pslt[j])
+			pslt[j] = nmTraceAllocHeap(&tr, 0 == _rpRand(&seed) % 16 ? _rpRand(&seed) % 8192 + 1 : _rpRand(&seed) % 256 + 1);
+		else if (0 == _rpRand(&seed) % 4)
+		{
+			void * p = nmTraceReallocHeap(&tr, pslt[j], _rpRand(&seed) % 1024 + 1);
+			if (NULL != p)
+				pslt[j] = p;
+		}
+		else
+		{
+			nmTraceFreeHeap(&tr, pslt[j]);
+			pslt[j] = NULL;
+		}
+	}
+	for (j = 0; j < GEN_SLT; ++j)
+		nmTraceFreeHeap(&tr, pslt[j]);
+
+	nmCloseTrace(&tr);
+	free(pbase);
+	return 0;
+}
+
+/* Function name: rpReplay
+ * Description:   Replay a trace and print the result.
+ * Parameters:
+ *       path Name of the trace file.
+ *       size ph->size for the replay heap. 0 for the recorded one.
+ *     hshsiz Count of hash table entrances. 0 for the recorded one.
+ *      flags Heap creation flags. (size_t)-1 for the recorded ones.
+ * Return value:  0: Succeeded. 1: Failed.
+ */
+static int rpReplay(const char * path, size_t size, size_t hshsiz, size_t flags)
+{
+	TRACE_DATA td;
+	REPLAY_RESULT rr;
+	P_HEAP_HEADER ph;
+	void * pbase;
+	size_t total;
+	int r = 1;
+
+	if (!nmLoadTrace(&td, path))
+	{
+		fprintf(stderr, "Cannot load trace %s.\n", path);
+		return 1;
+	}
+	size   = 0 == size ? td.size : size;
+	hshsiz = 0 == hshsiz ? td.hshsiz : hshsiz;
+	flags  = (size_t)-1 == flags ? td.flags : flags;
+
+	total = nmMeasureHeap(size, hshsiz, flags);
+	if (0 != total && NULL != (pbase = malloc(total)))
+	{
+		if (NULL != (ph = nmCreateHeapEx(pbase, total, hshsiz, flags)) && nmReplayTrace(&td, ph, &rr))
+		{
+			printf("Trace:          %zu records, %.3f s recorded.\n", td.count, rr.span);
+			printf("Heap:           %zu bytes, %zu entrances, flags 0x%zx.\n", ph->size, hshsiz, flags);
+			printf("Throughput:     %.2f Mops/s (%.1f ns/op).\n", rr.ops / rr.seconds / 1e6, rr.seconds * 1e9 / (rr.ops ? rr.ops : 1));
+			printf("Peak used:      %zu bytes (%.1f%% of heap).\n", rr.peakused, 100.0 * rr.peakused / ph->size);
+			printf("Peak footprint: %zu bytes (%.1f%% of heap).\n", rr.peakfoot, 100.0 * rr.peakfoot / ph->size);
+			printf("Fragmentation:  %.3f at worst (1 - biggest free / all free).\n", rr.maxfrag);
+			printf("Failures:       %zu.\n", rr.fails);
+			r = 0;
+		}
+		free(pbase);
+	}
+	nmUnloadTrace(&td);
+	return r;
+}
+
+/* Function name: rpCompare
+ * Description:   Replay a trace once for each placement policy and print a table.
+ * Parameters:
+ *       path Name of the trace file.
+ *       size ph->size for the replay heaps. 0 for the recorded one.
+ *     hshsiz Count of hash table entrances. 0 for the recorded one.
+ * Return value:  0: Succeeded. 1: Failed.
+ * Tip:           The bin policy of the recorded heap is kept. Only the placement flags change.
+ */
+static int rpCompare(const char * path, size_t size, size_t hshsiz)
+{
+	TRACE_DATA td;
+	REPLAY_RESULT rr;
+	P_HEAP_HEADER ph;
+	void * pbase;
+	size_t i, flags, total;
+
+	if (!nmLoadTrace(&td, path))
+	{
+		fprintf(stderr, "Cannot load trace %s.\n", path);
+		return 1;
+	}
+	size   = 0 == size ? td.size : size;
+	hshsiz = 0 == hshsiz ? td.hshsiz : hshsiz;
+
+	/* Placement flags do not change the layout of the header. */
+	total = nmMeasureHeap(size, hshsiz, td.flags);
+	if (0 == total || NULL == (pbase = malloc(total)))
+	{
+		nmUnloadTrace(&td);
+		return 1;
+	}
+
+	printf("Trace:          %zu records, %zu entrances.\n", td.count, hshsiz);
+	printf("%-18s %16s %14s %9s %9s\n", "Policy", "Peak footprint", "Fragmentation", "Failures", "Mops/s");
+	for (i = 0; i < sizeof(rpPolicy) / sizeof(rpPolicy[0]); ++i)
+	{
+		flags = (td.flags & ~(size_t)(HF_ADDRESS | HF_BEST)) | rpPolicy[i].flags;
+		if (NULL == (ph = nmCreateHeapEx(pbase, total, hshsiz, flags)) || !nmReplayTrace(&td, ph, &rr))
+		{
+			printf("%-18s %16s\n", rpPolicy[i].name, "n/a");
+			continue;
+		}
+		printf("%-18s %16zu %14.3f %9zu %9.2f\n", rpPolicy[i].name, rr.peakfoot, rr.maxfrag, rr.fails,
+			rr.ops / rr.seconds / 1e6);
+	}
+
+	free(pbase);
+	nmUnloadTrace(&td);
+	return 0;
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc >= 3 && 0 == strcmp(argv[1], "-g"))
+		return rpGenerate(argv[2], argc > 3 ? strtoul(argv[3], NULL, 0) : GEN_OPS);
+	else if (argc >= 3 && 0 == strcmp(argv[1], "-p"))
+		return rpCompare(argv[2],
+			argc > 3 ? strtoul(argv[3], NULL, 0) : 0,
+			argc > 4 ? strtoul(argv[4], NULL, 0) : 0);
+	else if (argc >= 2 && '-' != argv[1][0])
+		return rpReplay(argv[1],
+			argc > 2 ? strtoul(argv[2], NULL, 0) : 0,
+			argc > 3 ? strtoul(argv[3], NULL, 0) : 0,
+			argc > 4 ? strtoul(argv[4], NULL, 0) : (size_t)-1);
+
+	fprintf(stderr, "Usage: %s trace [size [hshsiz [flags]]]\n       %s -p trace [size [hshsiz]]\n       %s -g trace [ops]\n",
+		argv[0], argv[0], argv[0]);
+	return 1;
+}
@@ -0,0 +1,275 @@
+/*
+ * Name:        nmshare.c
+ * Description: Neo malloc heaps shared by processes.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1610260009P1610260010L00275
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* One process creates the heap in shared memory, the others attach to it:
+ *     psh = nmCreateSharedHeap(pbase, size, hshsiz, HF_NONE);    Creator.
+ *     psh = nmAttachSharedHeap(pbase, size);                     Every other process.
+ *     p = nmAllocSharedHeap(psh, n);
+ *     off = nmSharedOffset(psh, p);                              Hand off to another process.
+ *     p = nmSharedPointer(psh, off);                             Taken over by that process.
+ *     nmFreeSharedHeap(psh, p);
+ * Build with NM_OFFSETS to map the memory at a different address in each process.
+ * Otherwise every process has to map it at the address of the creator.
+ */
+
+#define _XOPEN_SOURCE 700 /* Using function pthread_mutexattr_setpshared and pthread_mutexattr_setrobust. */
+#include "nmshare.h"
+#include <errno.h>        /* Using macro EOWNERDEAD. */
+#include <limits.h>       /* Using macro CHAR_BIT. */
+
+/* [SHARED HEAP DIAGRAM]
+ * +=SHARED_HEAP=+<------ pbase in every process.
+ * | mtx         |        Robust and process-shared. A dead owner is found by the next locker.
+ * | pbase       |        Only checked when links are pointers.
+ * | recovers    |
+ * | bbroken     |
+ * +=HEAP_HEADER=+<------ SHARED_HEAP(psh), computed in each process. No process address is kept.
+ * |    ...      |
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+
+/* Usable macros. */
+#define SHARED_QUANTUM  (sizeof(size_t) * CHAR_BIT / 4)
+#define SHARED_SIZE     ((sizeof(SHARED_HEAP) + SHARED_QUANTUM - 1) / SHARED_QUANTUM * SHARED_QUANTUM)
+#define SHARED_HEAP(psh) ((P_HEAP_HEADER)((PUCHAR)(psh) + SHARED_SIZE))
+
+/* File level function declarations. */
+static bool _nmLockShared (P_SHARED_HEAP psh);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmLockShared
+ * Description:   Lock a shared heap. Take the lock over if its owner died.
+ * Parameter:
+ *        psh Pointer to shared heap.
+ * Return value:  true: Locked. false: The heap is broken and not locked.
+ * Tip:           A process that died inside a heap call may have left it half updated.
+ *                The heap is kept if nmCheckHeap finds nothing wrong. Otherwise it is marked broken.
+ *                Blocks that the dead process owned stay used either way.
+ */
+static bool _nmLockShared(P_SHARED_HEAP psh)
+{
+	register int r = pthread_mutex_lock(&psh->mtx);
+
+	if (EOWNERDEAD == r)
+	{
+		++psh->recovers;
+		if (!psh->bbroken && HC_OK != nmCheckHeap(SHARED_HEAP(psh)))
+			psh->bbroken = true;
+		r = pthread_mutex_consistent(&psh->mtx);
+	}
+	if (0 != r)
+		return false; /* ENOTRECOVERABLE: A former owner died and nobody could recover. */
+
+	if (psh->bbroken)
+	{
+		pthread_mutex_unlock(&psh->mtx);
+		return false;
+	}
+	return true;
+}
+
+/* Function name: nmCreateSharedHeap
+ * Description:   Create a heap that processes can share from a shared memory buffer.
+ * Parameters:
+ *      pbase Shared memory starting address, such as a MAP_SHARED mapping.
+ *       size Size of the whole buffer.(Unit in byte)
+ *     hshsiz Count of hash table entrances.
+ *      flags Heap creation flags, see nmCreateHeapEx. HF_GROW is not allowed.
+ * Return value:  NULL: Failed.
+ *                Pointer to shared heap(same as pbase): Succeeded.
+ * Tip:           The heap itself starts right after SHARED_HEAP in the buffer.
+ *                Create the heap before any other process attaches to it.
+ */
+P_SHARED_HEAP nmCreateSharedHeap(void * pbase, size_t size, size_t hshsiz, size_t flags)
+{
+	register P_SHARED_HEAP psh = (P_SHARED_HEAP)pbase;
+	pthread_mutexattr_t attr;
+	register int r;
+
+	/* Regions of a provider would be mapped in one process only. */
+	if (NULL == pbase || size < SHARED_SIZE || (HF_GROW & flags))
+		return NULL;
+
+	if (NULL == nmCreateHeapEx(SHARED_HEAP(psh), size - SHARED_SIZE, hshsiz, flags))
+		return NULL;
+
+	if (0 != pthread_mutexattr_init(&attr))
+		return NULL;
+	r = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if (0 == r)
+		r = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (0 == r)
+		r = pthread_mutex_init(&psh->mtx, &attr);
+	pthread_mutexattr_destroy(&attr);
+	if (0 != r)
+		return NULL;
+
+	psh->pbase    = pbase;
+	psh->recovers = 0;
+	psh->bbroken  = false;
+
+	return psh;
+}
+
+/* Function name: nmAttachSharedHeap
+ * Description:   Use a shared heap that another process created.
+ * Parameters:
+ *      pbase Address where this process mapped the shared memory.
+ *       size Size of the mapping.(Unit in byte)
+ * Return value:  NULL: Failed.
+ *                Pointer to shared heap(same as pbase): Succeeded.
+ * Tip:           Without NM_OFFSETS, pbase must be the address the creator used.
+ *                Children forked after nmCreateSharedHeap may use the heap without attaching.
+ */
+P_SHARED_HEAP nmAttachSharedHeap(void * pbase, size_t size)
+{
+	register P_SHARED_HEAP psh = (P_SHARED_HEAP)pbase;
+
+	if (NULL == pbase || size < SHARED_SIZE + sizeof(HEAP_HEADER))
+		return NULL;
+
+	if (HF_OFFSETS & SHARED_HEAP(psh)->flags)
+		return NULL == nmAttachHeap(SHARED_HEAP(psh), size - SHARED_SIZE) ? NULL : psh;
+
+	return pbase == psh->pbase ? psh : NULL;
+}
+
+/* Function name: nmDestroySharedHeap
+ * Description:   Release the lock of a shared heap.
+ * Parameter:
+ *        psh Pointer to shared heap.
+ * Return value:  N/A.
+ * Tip:           Call it once, after every process stopped using the heap.
+ *                The buffer may be reused after calling this function.
+ */
+void nmDestroySharedHeap(P_SHARED_HEAP psh)
+{
+	pthread_mutex_destroy(&psh->mtx);
+}
+
+/* Function name: nmLockSharedHeap
+ * Description:   Lock a shared heap to call heap functions on it directly.
+ * Parameter:
+ *        psh Pointer to shared heap.
+ * Return value:  NULL: The heap is broken and not locked.
+ *                Pointer to heap header: Locked.
+ * Tip:           Use it to run nmFreeBatch, nmGetHeapStats and such under one lock.
+ *                Call nmUnlockSharedHeap afterwards.
+ */
+P_HEAP_HEADER nmLockSharedHeap(P_SHARED_HEAP psh)
+{
+	return _nmLockShared(psh) ? SHARED_HEAP(psh) : NULL;
+}
+
+/* Function name: nmUnlockSharedHeap
+ * Description:   Unlock a shared heap locked by nmLockSharedHeap.
+ * Parameter:
+ *        psh Pointer to shared heap.
+ * Return value:  N/A.
+ */
+void nmUnlockSharedHeap(P_SHARED_HEAP psh)
+{
+	pthread_mutex_unlock(&psh->mtx);
+}
+
+/* Function name: nmAllocSharedHeap
+ * Description:   Process-safe heap allocation.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ */
+void * nmAllocSharedHeap(P_SHARED_HEAP psh, size_t size)
+{
+	register void * p;
+
+	if (!_nmLockShared(psh))
+		return NULL;
+	p = nmAllocHeap(SHARED_HEAP(psh), size);
+	pthread_mutex_unlock(&psh->mtx);
+
+	return p;
+}
+
+/* Function name: nmFreeSharedHeap
+ * Description:   Process-safe heap freedom.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *        ptr Pointer in heap that you want to free. Any process may free it.
+ * Return value:  N/A.
+ */
+void nmFreeSharedHeap(P_SHARED_HEAP psh, void * ptr)
+{
+	if (NULL == ptr || !_nmLockShared(psh))
+		return;
+	nmFreeHeap(SHARED_HEAP(psh), ptr);
+	pthread_mutex_unlock(&psh->mtx);
+}
+
+/* Function name: nmReallocSharedHeap
+ * Description:   Process-safe heap reallocation.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *        ptr Pointer in heap that you want to reallocate.
+ *       size New size of memory chunk.
+ * Return value:  NULL: Reallocation failed.
+ *                Pointer to heap memory: Succeeded.
+ */
+void * nmReallocSharedHeap(P_SHARED_HEAP psh, void * ptr, size_t size)
+{
+	register void * p;
+
+	if (!_nmLockShared(psh))
+		return NULL;
+	p = nmReallocHeap(SHARED_HEAP(psh), ptr, size);
+	pthread_mutex_unlock(&psh->mtx);
+
+	return p;
+}
+
+/* Function name: nmSharedOffset
+ * Description:   Turn a block into an offset that means the same block in every process.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *        ptr Pointer to a block of the heap or NULL.
+ * Return value:  Offset from the shared heap. 0 for NULL.
+ */
+size_t nmSharedOffset(P_SHARED_HEAP psh, void * ptr)
+{
+	return NULL == ptr ? 0 : (size_t)((PUCHAR)ptr - (PUCHAR)psh);
+}
+
+/* Function name: nmSharedPointer
+ * Description:   Turn an offset from nmSharedOffset into a block of this process.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *        off Offset from the shared heap.
+ * Return value:  Pointer to the block. NULL for 0.
+ */
+void * nmSharedPointer(P_SHARED_HEAP psh, size_t off)
+{
+	return 0 == off ? NULL : (PUCHAR)psh + off;
+}
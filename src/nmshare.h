@@ -0,0 +1,51 @@
+/*
+ * Name:        nmshare.h
+ * Description: Neo malloc heaps shared by processes.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1610260009P1610260010L00051
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMSHARE_H_
+#define _NMSHARE_H_
+
+#include "neomalloc.h"
+#include <pthread.h> /* Using type pthread_mutex_t. */
+
+/* Process-shared heap structure. It lies at the start of the shared memory. */
+typedef struct st_SharedHeap
+{
+	pthread_mutex_t mtx;      /* Robust lock of the heap, shared by processes. */
+	void *          pbase;    /* Address of the memory in the process that created the heap. */
+	size_t          recovers; /* Count of times the lock was taken over from a dead owner. */
+	bool            bbroken;  /* A dead owner left the heap inconsistent. Every later call fails. */
+} SHARED_HEAP, * P_SHARED_HEAP;
+
+/* Exported functions. */
+P_SHARED_HEAP nmCreateSharedHeap (void *        pbase, size_t size, size_t hshsiz, size_t flags);
+P_SHARED_HEAP nmAttachSharedHeap (void *        pbase, size_t size);
+void          nmDestroySharedHeap(P_SHARED_HEAP psh);
+P_HEAP_HEADER nmLockSharedHeap   (P_SHARED_HEAP psh);
+void          nmUnlockSharedHeap (P_SHARED_HEAP psh);
+void *        nmAllocSharedHeap  (P_SHARED_HEAP psh,   size_t size);
+void          nmFreeSharedHeap   (P_SHARED_HEAP psh,   void * ptr);
+void *        nmReallocSharedHeap(P_SHARED_HEAP psh,   void * ptr,  size_t size);
+size_t        nmSharedOffset     (P_SHARED_HEAP psh,   void * ptr);
+void *        nmSharedPointer    (P_SHARED_HEAP psh,   size_t off);
+
+#endif
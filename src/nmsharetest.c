@@ -0,0 +1,289 @@
+/*
+ * Name:        nmsharetest.c
+ * Description: Neo malloc tests of heaps shared by processes.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1610260048Q1610260048L00289
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Build: cc -O2 -std=c11 -pthread neomalloc.c nmshare.c nmsharetest.c -o nmsharetest
+ *        Build once more with -DNM_OFFSETS to test heaps mapped at another address.
+ * Exit status 0 means every test passed. Otherwise it tells which test failed.
+ */
+
+#define _XOPEN_SOURCE 700 /* Using function mkstemp, ftruncate, fork and kill. */
+#include "nmshare.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SHM_SIZ (1 << 20) /* Size of each shared mapping. */
+#define SHM_OPS 20000     /* Operations of each process in the fork test. */
+#define SHM_SLT 64        /* Live slots of each process in the fork test. */
+#define SHM_BLK 200       /* Size of the block handed over by offset. */
+
+/* Function name: tsMap
+ * Description:   Map a fresh shared file, optionally twice at different addresses.
+ * Parameters:
+ *         pp Receives the first mapping.
+ *        pp2 NULL, or receives a second mapping of the same file.
+ * Return value:  true: Succeeded. false: Failed.
+ */
+bool tsMap(void ** pp, void ** pp2)
+{
+	char path[] = "/tmp/nmshareXXXXXX";
+	int fd = mkstemp(path);
+
+	if (-1 == fd)
+		return false;
+	unlink(path);
+	if (0 != ftruncate(fd, SHM_SIZ))
+	{
+		close(fd);
+		return false;
+	}
+	*pp = mmap(NULL, SHM_SIZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (NULL != pp2)
+		*pp2 = mmap(NULL, SHM_SIZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return MAP_FAILED != *pp && (NULL == pp2 || MAP_FAILED != *pp2);
+}
+
+/* Function name: tsChurn
+ * Description:   Allocate and free blocks of a shared heap and check that nobody else wrote into them.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *       seed Seed of the workload. It also marks the blocks of this process.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsChurn(P_SHARED_HEAP psh, size_t seed)
+{
+	unsigned char * pslt[SHM_SLT] = { NULL };
+	size_t i, j, k, mark = seed & 0xff;
+
+	for (i = 0; i < SHM_OPS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 16) % SHM_SLT;
+		if (NULL == pslt[j])
+		{
+			if (NULL != (pslt[j] = nmAllocSharedHeap(psh, 1 + (seed >> 8) % 512)))
+				memset(pslt[j], (int)mark, nmSizeHeap(pslt[j]));
+			continue;
+		}
+		for (k = 0; k < nmSizeHeap(pslt[j]); ++k)
+			if (mark != pslt[j][k])
+				return false;
+		nmFreeSharedHeap(psh, pslt[j]);
+		pslt[j] = NULL;
+	}
+	for (j = 0; j < SHM_SLT; ++j)
+		nmFreeSharedHeap(psh, pslt[j]);
+	return true;
+}
+
+/* Function name: tsClose
+ * Description:   Check that a shared heap is whole and empty, then release it and its mappings.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *      pbase Its mapping.
+ *     pbase2 NULL or a second mapping of it.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsClose(P_SHARED_HEAP psh, void * pbase, void * pbase2)
+{
+	P_HEAP_HEADER ph;
+	HEAP_STATS st;
+	bool r;
+
+	if (NULL == (ph = nmLockSharedHeap(psh)))
+		return false;
+	st.pbin = NULL;
+	nmGetHeapStats(ph, &st);
+	r = HC_OK == nmCheckHeap(ph) && 1 == st.freecnt && 0 == psh->recovers;
+	nmUnlockSharedHeap(psh);
+
+	nmDestroySharedHeap(psh);
+	munmap(pbase, SHM_SIZ);
+	if (NULL != pbase2)
+		munmap(pbase2, SHM_SIZ);
+	return r;
+}
+
+/* Function name: tsAttach
+ * Description:   Use one shared heap through two mappings at different addresses.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsAttach(void)
+{
+	P_SHARED_HEAP psh, psh2;
+	void * pbase, * pbase2;
+	char * p;
+
+	if (!tsMap(&pbase, &pbase2) || NULL == (psh = nmCreateSharedHeap(pbase, SHM_SIZ, 16, HF_NONE)))
+		return false;
+	if (NULL == (p = (char *)nmAllocSharedHeap(psh, SHM_BLK)))
+		return false;
+	strcpy(p, "from the first mapping");
+#ifdef NM_OFFSETS
+	/* The same offset means the same block in the other mapping. */
+	if (NULL == (psh2 = nmAttachSharedHeap(pbase2, SHM_SIZ)) ||
+		0 != strcmp(nmSharedPointer(psh2, nmSharedOffset(psh, p)), "from the first mapping"))
+		return false;
+	nmFreeSharedHeap(psh2, nmSharedPointer(psh2, nmSharedOffset(psh, p)));
+#else
+	/* Links are pointers, so only the address of the creator will do. */
+	if (NULL != nmAttachSharedHeap(pbase2, SHM_SIZ) || psh != (psh2 = nmAttachSharedHeap(pbase, SHM_SIZ)))
+		return false;
+	nmFreeSharedHeap(psh2, p);
+#endif
+	return tsClose(psh, pbase, pbase2);
+}
+
+/* Function name: tsFork
+ * Description:   Share a heap between a parent and a forked child, which hands a block over by offset.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsFork(void)
+{
+	P_SHARED_HEAP psh;
+	void * pbase;
+	size_t * pbox, i;
+	unsigned char * p;
+	pid_t pid;
+	int st;
+
+	if (!tsMap(&pbase, NULL) || NULL == (psh = nmCreateSharedHeap(pbase, SHM_SIZ, 16, HF_TLSF | HF_SLI(2))))
+		return false;
+	/* The mailbox lies in the heap, so the child finds it at the same offset. */
+	if (NULL == (pbox = (size_t *)nmAllocSharedHeap(psh, sizeof(size_t))))
+		return false;
+	*pbox = 0;
+
+	if (-1 == (pid = fork()))
+		return false;
+	if (0 == pid)
+	{
+		if (!tsChurn(psh, 7) || NULL == (p = (unsigned char *)nmAllocSharedHeap(psh, SHM_BLK)))
+			_exit(1);
+		for (i = 0; i < SHM_BLK; ++i)
+			p[i] = (unsigned char)i;
+		*pbox = nmSharedOffset(psh, p);
+		_exit(0);
+	}
+
+	if (!tsChurn(psh, 11) || pid != waitpid(pid, &st, 0) || !WIFEXITED(st) || 0 != WEXITSTATUS(st))
+		return false;
+
+	/* The parent owns the block now and frees it. */
+	if (NULL == (p = (unsigned char *)nmSharedPointer(psh, *pbox)))
+		return false;
+	for (i = 0; i < SHM_BLK; ++i)
+		if ((unsigned char)i != p[i])
+			return false;
+	nmFreeSharedHeap(psh, p);
+	nmFreeSharedHeap(psh, pbox);
+	return tsClose(psh, pbase, NULL);
+}
+
+/* Function name: tsKill
+ * Description:   Fork a child that locks a shared heap, optionally corrupts it, and dies holding the lock.
+ * Parameters:
+ *        psh Pointer to shared heap.
+ *   bcorrupt Whether the child breaks a boundary tag before it dies.
+ * Return value:  true: The child died as planned. false: Failed.
+ */
+bool tsKill(P_SHARED_HEAP psh, bool bcorrupt)
+{
+	P_HEAP_HEADER ph;
+	unsigned char * p;
+	int fd[2], st;
+	bool bheld;
+	char c = 0;
+	pid_t pid;
+
+	if (0 != pipe(fd) || -1 == (pid = fork()))
+		return false;
+	if (0 == pid)
+	{
+		if (NULL == (ph = nmLockSharedHeap(psh)))
+			_exit(1);
+		if (bcorrupt && NULL != (p = (unsigned char *)nmAllocHeap(ph, 64)))
+			p[-1] ^= 0x40; /* A byte of the head note. Head and foot no longer match. */
+		if (1 != write(fd[1], &c, 1))
+			_exit(1);
+		for ( ; ; )
+			pause();
+	}
+
+	/* Kill the child once it holds the lock. */
+	close(fd[1]);
+	bheld = 1 == read(fd[0], &c, 1);
+	close(fd[0]);
+	kill(pid, SIGKILL);
+	return pid == waitpid(pid, &st, 0) && WIFSIGNALED(st) && bheld;
+}
+
+/* Function name: tsRecover
+ * Description:   Take a shared heap over from owners that died holding its lock.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsRecover(void)
+{
+	P_SHARED_HEAP psh;
+	void * pbase, * p;
+
+	if (!tsMap(&pbase, NULL) || NULL == (psh = nmCreateSharedHeap(pbase, SHM_SIZ, 16, HF_NONE)))
+		return false;
+
+	/* The heap was left consistent, so the next locker goes on with it. */
+	if (!tsKill(psh, false) || NULL == (p = nmAllocSharedHeap(psh, 64)) || 1 != psh->recovers || psh->bbroken)
+		return false;
+	nmFreeSharedHeap(psh, p);
+
+	/* A broken heap fails every later call. */
+	if (!tsKill(psh, true) || NULL != nmAllocSharedHeap(psh, 64) || 2 != psh->recovers || !psh->bbroken)
+		return false;
+	if (NULL != nmLockSharedHeap(psh) || NULL != nmReallocSharedHeap(psh, NULL, 64))
+		return false;
+
+	nmDestroySharedHeap(psh);
+	munmap(pbase, SHM_SIZ);
+	return true;
+}
+
+int main()
+{
+	if (!tsAttach())
+		return 1;
+
+	if (!tsFork())
+		return 2;
+
+	if (!tsRecover())
+		return 3;
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * Name:        nmslab.c
+ * Description: Neo malloc small object slabs.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262315F1610260057L00269
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nmslab.h"
+#include <string.h>  /* Using function memset. */
+
+/* [SLAB RUN DIAGRAM]
+ * +=====RUN=====+<-------------------- Allocated by nmAllocAlignedHeap on a multiple of SLAB_RUN.
+ * | Run links   *--> Previous and next run of the slab, previous and next run of pavail[cls].
+ * | Free slots  *--> Next free slot of this run or NULL.
+ * | pcur, pend  |
+ * | live, cls   |
+ * +=============+<-------------------- Slots start at RUN_HEAD, a multiple of SLAB_QUANTUM.
+ * |   SLOT      *--> Next free slot while it is free, object data while it is used.
+ * |-------------|
+ * |   SLOT      |
+ * |-------------|
+ * |   ...       |<-------------------- pcur, slots beyond are never touched yet.
+ * +=============+<-------------------- pend.
+ * Every slot of a run has the same size. Slots carry no header.
+ * A slot finds its run by rounding its address down to SLAB_RUN.
+ * A run whose last used slot is freed goes back to the heap, unless it is the only run left in pavail[cls].
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+
+/* Run header structure. */
+typedef struct st_SlabRun
+{
+	struct st_SlabRun * pprev; /* Previous run of the slab. */
+	struct st_SlabRun * pnext; /* Next run of the slab. */
+	struct st_SlabRun * ppavl; /* Previous run in pavail[cls]. */
+	struct st_SlabRun * pnavl; /* Next run in pavail[cls]. */
+	void *              pfree; /* Linked list of free slots of this run. */
+	PUCHAR              pcur;  /* The next untouched slot. */
+	PUCHAR              pend;  /* End of slots. */
+	size_t              live;  /* Count of slots in use. */
+	size_t              cls;   /* Size class of the slots. */
+} SLAB_RUN_HEADER, * P_SLAB_RUN_HEADER;
+
+/* Usable macros. */
+#define SLOT_CLASS(size) (((size) + SLAB_QUANTUM - 1) / SLAB_QUANTUM - 1)
+#define SLOT_SIZE(i)     (((i) + 1) * SLAB_QUANTUM)
+#define NEXT_LINK(p)     (*(void **)(p))
+#define RUN_HEAD         ((sizeof(SLAB_RUN_HEADER) + SLAB_QUANTUM - 1) / SLAB_QUANTUM * SLAB_QUANTUM)
+#define RUN_OF(p)        ((P_SLAB_RUN_HEADER)((size_t)(p) & ~(size_t)(SLAB_RUN - 1)))
+#define RUN_FULL(pr)     (NULL == (pr)->pfree && (pr)->pcur == (pr)->pend)
+
+/* File level function declarations. */
+static P_SLAB_RUN_HEADER _nmNewRun  (P_SLAB_HEADER ps, size_t i);
+static void              _nmPushRun (P_SLAB_HEADER ps, P_SLAB_RUN_HEADER pr);
+static void              _nmPopRun  (P_SLAB_HEADER ps, P_SLAB_RUN_HEADER pr);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmNewRun
+ * Description:   Carve a new run from the heap for one size class.
+ * Parameters:
+ *         ps Pointer to slab header.
+ *          i Size class.
+ * Return value:  NULL: Heap is exhausted.
+ *                Pointer to the new run, which is linked into pavail[i]: Succeeded.
+ */
+static P_SLAB_RUN_HEADER _nmNewRun(P_SLAB_HEADER ps, size_t i)
+{
+	/* Boundary tags take SLAB_QUANTUM bytes, so a run with its tags fills SLAB_RUN bytes and runs pack side by side. */
+	register P_SLAB_RUN_HEADER pr = (P_SLAB_RUN_HEADER)nmAllocAlignedHeap(ps->ph, SLAB_RUN, SLAB_RUN - SLAB_QUANTUM);
+
+	if (NULL == pr)
+		return NULL;
+
+	pr->pprev = NULL;
+	pr->pnext = (P_SLAB_RUN_HEADER)ps->prun;
+	if (NULL != pr->pnext)
+		pr->pnext->pprev = pr;
+	ps->prun = pr;
+
+	/* Slots are handed out lazily, so untouched slots cost nothing but address space. */
+	pr->pfree = NULL;
+	pr->pcur  = (PUCHAR)pr + RUN_HEAD;
+	pr->pend  = pr->pcur + (SLAB_RUN - SLAB_QUANTUM - RUN_HEAD) / SLOT_SIZE(i) * SLOT_SIZE(i);
+	pr->live  = 0;
+	pr->cls   = i;
+
+	_nmPushRun(ps, pr);
+	return pr;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPushRun
+ * Description:   Link a run at the front of the available runs of its class.
+ * Parameters:
+ *         ps Pointer to slab header.
+ *         pr Pointer to run header.
+ * Return value:  N/A.
+ */
+static void _nmPushRun(P_SLAB_HEADER ps, P_SLAB_RUN_HEADER pr)
+{
+	pr->ppavl = NULL;
+	pr->pnavl = (P_SLAB_RUN_HEADER)ps->pavail[pr->cls];
+	if (NULL != pr->pnavl)
+		pr->pnavl->ppavl = pr;
+	ps->pavail[pr->cls] = pr;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPopRun
+ * Description:   Unlink a run from the available runs of its class.
+ * Parameters:
+ *         ps Pointer to slab header.
+ *         pr Pointer to run header.
+ * Return value:  N/A.
+ */
+static void _nmPopRun(P_SLAB_HEADER ps, P_SLAB_RUN_HEADER pr)
+{
+	if (NULL != pr->ppavl)
+		pr->ppavl->pnavl = pr->pnavl;
+	else
+		ps->pavail[pr->cls] = pr->pnavl;
+	if (NULL != pr->pnavl)
+		pr->pnavl->ppavl = pr->ppavl;
+}
+
+/* Function name: nmCreateSlab
+ * Description:   Create slabs on a heap.
+ * Parameter:
+ *         ph Pointer to heap header.
+ * Return value:  NULL: Failed.
+ *                Pointer to slab header which is allocated from ph: Succeeded.
+ * Tip:           Runs come from nmAllocAlignedHeap, so the heap must have been created on an address aligned to ALIGN.
+ */
+P_SLAB_HEADER nmCreateSlab(P_HEAP_HEADER ph)
+{
+	P_SLAB_HEADER ps = (P_SLAB_HEADER)nmAllocHeap(ph, sizeof(SLAB_HEADER));
+
+	if (NULL != ps)
+	{
+		memset(ps, 0, sizeof(SLAB_HEADER));
+		ps->ph = ph;
+	}
+	return ps;
+}
+
+/* Function name: nmDestroySlab
+ * Description:   Give every run and the slab header back to the heap.
+ * Parameter:
+ *         ps Pointer to slab header.
+ * Return value:  N/A.
+ * Tip:           Objects allocated from slabs become invalid after calling this function.
+ *                Objects bigger than SLAB_MAX live in the heap and must be freed by nmFreeSlab before.
+ */
+void nmDestroySlab(P_SLAB_HEADER ps)
+{
+	register P_SLAB_RUN_HEADER pr, pnext;
+
+	for (pr = (P_SLAB_RUN_HEADER)ps->prun; NULL != pr; pr = pnext)
+	{
+		pnext = pr->pnext;
+		nmFreeHeap(ps->ph, pr);
+	}
+	nmFreeHeap(ps->ph, ps);
+}
+
+/* Function name: nmAllocSlab
+ * Description:   Allocate an object. Sizes up to SLAB_MAX are served from slots.
+ * Parameters:
+ *         ps Pointer to slab header.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to an object aligned to SLAB_QUANTUM: Succeeded.
+ */
+void * nmAllocSlab(P_SLAB_HEADER ps, size_t size)
+{
+	register P_SLAB_RUN_HEADER pr;
+	register size_t i;
+	register void * p;
+
+	if (size > SLAB_MAX)
+		return nmAllocHeap(ps->ph, size);
+
+	i = 0 == size ? 0 : SLOT_CLASS(size);
+
+	/* Carve a new run when every run of this class is used up. */
+	if (NULL == (pr = (P_SLAB_RUN_HEADER)ps->pavail[i]) && NULL == (pr = _nmNewRun(ps, i)))
+		return NULL;
+
+	/* Reuse a freed slot, otherwise take an untouched one. */
+	if (NULL != (p = pr->pfree))
+		pr->pfree = NEXT_LINK(p);
+	else
+	{
+		p = pr->pcur;
+		pr->pcur += SLOT_SIZE(i);
+	}
+
+	++pr->live;
+	if (RUN_FULL(pr))
+		_nmPopRun(ps, pr);
+	return p;
+}
+
+/* Function name: nmFreeSlab
+ * Description:   Free an object.
+ * Parameters:
+ *         ps Pointer to slab header.
+ *        ptr Pointer to an object allocated by nmAllocSlab.
+ *       size The same size that was passed to nmAllocSlab.
+ * Return value:  N/A.
+ * Tip:           Slots have no header, so callers pass the size back to tell slots from heap blocks.
+ *                A run goes back to the heap once all of its slots are free,
+ *                except the last available run of a class, which is kept to damp churn.
+ */
+void nmFreeSlab(P_SLAB_HEADER ps, void * ptr, size_t size)
+{
+	register P_SLAB_RUN_HEADER pr;
+
+	if (NULL == ptr)
+		return;
+
+	if (size > SLAB_MAX)
+	{
+		nmFreeHeap(ps->ph, ptr);
+		return;
+	}
+
+	/* Move the run to the front of its class, so the slot is reused while it is still in cache. */
+	pr = RUN_OF(ptr);
+	if (ps->pavail[pr->cls] != pr)
+	{
+		if (!RUN_FULL(pr))
+			_nmPopRun(ps, pr);
+		_nmPushRun(ps, pr);
+	}
+	NEXT_LINK(ptr) = pr->pfree;
+	pr->pfree = ptr;
+
+	if (0 != --pr->live || (ps->pavail[pr->cls] == pr && NULL == pr->pnavl))
+		return;
+
+	/* The run is empty and another run of its class has room. */
+	_nmPopRun(ps, pr);
+	if (NULL != pr->pprev)
+		pr->pprev->pnext = pr->pnext;
+	else
+		ps->prun = pr->pnext;
+	if (NULL != pr->pnext)
+		pr->pnext->pprev = pr->pprev;
+	nmFreeHeap(ps->ph, pr);
+}
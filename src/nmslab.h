@@ -0,0 +1,48 @@
+/*
+ * Name:        nmslab.h
+ * Description: Neo malloc small object slabs.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262315E1610260119L00048
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMSLAB_H_
+#define _NMSLAB_H_
+
+#include "neomalloc.h"
+
+#define SLAB_QUANTUM NM_ALIGN /* Slot sizes and slot addresses are multiples of this, like heap blocks. */
+#define SLAB_MAX     256  /* The biggest size served by slabs. Bigger sizes go to the heap. */
+#define SLAB_RUN     4096 /* Size and alignment of one run of slots. Must be a power of two. */
+#define SLAB_CLASSES (SLAB_MAX / SLAB_QUANTUM)
+
+/* Slab header structure. */
+typedef struct st_SlabHeader
+{
+	P_HEAP_HEADER ph;                   /* Heap that runs are carved from. */
+	void *        prun;                 /* Linked list of every run. */
+	void *        pavail[SLAB_CLASSES]; /* Linked lists of runs that still have a free or untouched slot. */
+} SLAB_HEADER, * P_SLAB_HEADER;
+
+/* Exported functions. */
+P_SLAB_HEADER nmCreateSlab  (P_HEAP_HEADER ph);
+void          nmDestroySlab (P_SLAB_HEADER ps);
+void *        nmAllocSlab   (P_SLAB_HEADER ps, size_t size);
+void          nmFreeSlab    (P_SLAB_HEADER ps, void * ptr, size_t size);
+
+#endif
@@ -2,7 +2,7 @@
  * Name:        neomalloc.c
  * Description: Neo malloc core function.
  * Author:      cosh.cage#hotmail.com
- * File ID:     1207250701C1207250908L00065
+ * File ID:     1207250701C1610260122L01225
  * License:     LGPLv3
  * Copyright (C) 2025 John Cage
  *
@@ -21,17 +21,1178 @@
  *
  */
 
+/* Build: cc -std=c11 -pthread neomalloc.c nmslab.c nmarena.c nmthread.c nmtrace.c nmtest.c -o nmtest
+ * Exit status 0 means every test passed. Otherwise it tells which test failed.
+ */
+
 #include "neomalloc.h"
+#include "nmarena.h"
+#include "nmslab.h"
+#include "nmthread.h"
+#include "nmtrace.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define SIZ 128
+#define SIZ (sizeof(HEAP_HEADER) + 104) /* Heap size for the smoke test. Room beyond the header stays the same under NM_STATS. */
+#define RCL_SIZ 65536 /* Heap size for reclamation test. */
+#define RCL_SLT 256   /* Live slots for reclamation test. */
+#define RCL_OPS 20000 /* Operations of the mixed workload. */
+#define ALN_CNT 32    /* Blocks of the aligned allocation test. */
+
+/* Boundary tags and links as tsCheck plants corruptions into them. */
+#ifdef NM_COMPACT
+typedef uint32_t TS_WORD;
+#else
+typedef size_t   TS_WORD;
+#endif
+#define BAT_CNT 100   /* Blocks of the batch test. */
+#define SLB_SIZ (1 << 20) /* Heap size for the slab test. Every size class takes a run. */
+#define SYN_THR 4     /* Threads of the thread cache test. */
+#define SYN_SLT 32    /* Live slots of each thread of the thread cache test. */
+#define TRC_OPS 4000  /* Recorded calls of the trace test. */
+#define TRC_NAM "nmtest.trc" /* Trace file of the trace test. It is removed afterwards. */
 
 char buff[SIZ * 2];
+char rbuf[RCL_SIZ];
+char sbuf[SLB_SIZ];
+
+/* Function name: tsReclaim
+ * Description:   Run a long mixed workload, then allocate the smallest blocks until the heap is exhausted.
+ * Parameter:
+ *     hshsiz Count of hash table entrances.
+ * Return value:  Bytes that could be reclaimed by the smallest allocations.
+ */
+size_t tsReclaim(size_t hshsiz)
+{
+	P_HEAP_HEADER ph;
+	void * pslt[RCL_SLT] = { NULL };
+	size_t i, j, seed = 3, r = 0;
+
+	ph = nmCreateHeap(rbuf, RCL_SIZ, hshsiz);
+	if (NULL == ph)
+		return 0;
+
+	for (i = 0; i < RCL_OPS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % RCL_SLT;
+		if (NULL != pslt[j])
+		{
+			nmFreeHeap(ph, pslt[j]);
+			pslt[j] = NULL;
+		}
+		else
+			pslt[j] = nmAllocHeap(ph, 1 + (seed >> 16) % 256);
+	}
+
+	/* Leave every eighth block in place and free the rest, so free space lies between used blocks. */
+	for (j = 0; j < RCL_SLT; ++j)
+		if (j % 8 && NULL != pslt[j])
+			nmFreeHeap(ph, pslt[j]);
+
+	while (NULL != nmAllocHeap(ph, 1))
+		r += sizeof(size_t) * CHAR_BIT / 4;
+
+	return r;
+}
+
+/* Function name: tsRealloc
+ * Description:   Grow blocks that cannot grow forward and check that payloads survive.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsRealloc(void)
+{
+	P_HEAP_HEADER ph;
+	unsigned char * pa, * pb, * pc, * pd, * pn;
+	size_t i;
+
+	ph = nmCreateHeap(rbuf, RCL_SIZ, 16);
+	if (NULL == ph)
+		return false;
+
+	pa = nmAllocHeap(ph, 64);
+	pb = nmAllocHeap(ph, 64);
+	pc = nmAllocHeap(ph, 64); /* Keeps pb from growing forward. */
+	pd = nmAllocHeap(ph, 64); /* Keeps pc from growing forward. */
+	if (NULL == pa || NULL == pb || NULL == pc || NULL == pd)
+		return false;
+	memset(pb, 0x5a, 64);
+
+	/* Only the freed block before pb has room, so pb slides down onto it. */
+	nmFreeHeap(ph, pa);
+	pn = nmReallocHeap(ph, pb, 112);
+	if (pn != pa)
+		return false;
+	for (i = 0; i < 64; ++i)
+		if (0x5a != pn[i])
+			return false;
+
+	/* No room on either side. The whole payload must move. */
+	memset(pc, 0xa5, 64);
+	pn = nmReallocHeap(ph, pc, 1024);
+	if (NULL == pn || pn == pc || pn < pd)
+		return false;
+	for (i = 0; i < 64; ++i)
+		if (0xa5 != pn[i])
+			return false;
+
+	/* A size near SIZE_MAX fails and leaves the block alone. */
+	if (NULL != nmReallocHeap(ph, pn, (size_t)-1 - 5) || 0xa5 != pn[63])
+		return false;
+
+	return true;
+}
+
+/* Function name: tsAligned
+ * Description:   Allocate blocks of several alignments, free them and check that the heap is whole again.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsAligned(void)
+{
+	P_HEAP_HEADER ph;
+	void * p[ALN_CNT], * pw;
+	size_t i, a;
+
+	/* Alignment is only guaranteed for heaps that start on an aligned address. */
+	a = (size_t)(-(ptrdiff_t)rbuf & 63);
+	ph = nmCreateHeap(rbuf + a, RCL_SIZ - 64, 16);
+	if (NULL == ph)
+		return false;
+
+	pw = nmAllocHeap(ph, RCL_SIZ / 2); /* The biggest block a whole heap can give. */
+	if (NULL == pw)
+		return false;
+	nmFreeHeap(ph, pw);
+
+	/* Sizes near SIZE_MAX must not round to a zero-size block. */
+	if (NULL != nmAllocAlignedHeap(ph, 64, (size_t)-1 - 5))
+		return false;
+
+	for (i = 0; i < ALN_CNT; ++i)
+	{
+		a = (size_t)32 << (i % 8);
+		p[i] = nmAllocAlignedHeap(ph, a, 1 + i * 7);
+		if (NULL == p[i] || 0 != ((size_t)p[i] & (a - 1)))
+			return false;
+		memset(p[i], 0xcc, 1 + i * 7);
+	}
+
+	for (i = 0; i < ALN_CNT; ++i)
+		nmFreeHeap(ph, p[i]);
+
+	pw = nmAllocHeap(ph, RCL_SIZ / 2);
+	return NULL != pw;
+}
+
+/* Function name: tsBatch
+ * Description:   Allocate and free blocks in batches and check that the heap is whole again.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsBatch(void)
+{
+	P_HEAP_HEADER ph;
+	void * p[BAT_CNT + 1];
+	size_t i;
+
+	ph = nmCreateHeap(rbuf, RCL_SIZ, 16);
+	if (NULL == ph)
+		return false;
+
+	/* Sizes near SIZE_MAX must not round to zero-size blocks. */
+	if (0 != nmAllocBatch(ph, (size_t)-1 - 3, 2, p))
+		return false;
+
+	if (BAT_CNT != nmAllocBatch(ph, 40, BAT_CNT, p))
+		return false;
+	for (i = 0; i < BAT_CNT; ++i)
+		memset(p[i], (int)i, 40);
+	for (i = 0; i < BAT_CNT; ++i)
+		if ((unsigned char)i != *(unsigned char *)p[i] || nmSizeHeap(p[i]) < 40)
+			return false;
+
+	/* Free every third block alone, the rest in one batch with a NULL among them. */
+	for (i = 0; i < BAT_CNT; i += 3)
+	{
+		nmFreeHeap(ph, p[i]);
+		p[i] = NULL;
+	}
+	p[BAT_CNT] = NULL;
+	nmFreeBatch(ph, p, BAT_CNT + 1);
+
+	return NULL != nmAllocHeap(ph, RCL_SIZ / 2);
+}
+
+/* Function name: tsCalloc
+ * Description:   Check that nmCallocHeap returns cleared memory, both fresh and reused.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsCalloc(void)
+{
+	P_HEAP_HEADER ph;
+	unsigned char * p;
+	size_t i, j;
+
+	memset(rbuf, 0, RCL_SIZ);
+	ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_ZEROED);
+	if (NULL == ph)
+		return false;
+
+	for (j = 0; j < 8; ++j)
+	{
+		p = nmCallocHeap(ph, j + 1, 100);
+		if (NULL == p)
+			return false;
+		for (i = 0; i < (j + 1) * 100; ++i)
+			if (0 != p[i])
+				return false;
+
+		/* Dirty the block, so that the next round gets reused memory. */
+		memset(p, 0xee, (j + 1) * 100);
+		if (j % 2)
+			nmFreeHeap(ph, p);
+	}
+
+	/* Neither the product nor sizes near SIZE_MAX may round to a small block. */
+	return NULL == nmCallocHeap(ph, (size_t)-1 / 2, 4) && NULL == nmCallocHeap(ph, 1, (size_t)-1 - 3) &&
+		NULL == nmAllocHeap(ph, (size_t)-1 - 3);
+}
+
+/* Function name: tsStats
+ * Description:   Check free chunk statistics and, with NM_STATS, the counters.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsStats(void)
+{
+	P_HEAP_HEADER ph;
+	HEAP_STATS st;
+	size_t bin[16], i, n = 0;
+	void * p[3];
+
+	ph = nmCreateHeap(rbuf, RCL_SIZ, 16);
+	if (NULL == ph)
+		return false;
+
+	for (i = 0; i < 3; ++i)
+		p[i] = nmAllocHeap(ph, 100);
+	nmFreeHeap(ph, p[1]); /* A hole between two used blocks. */
+
+	st.pbin = bin;
+	nmGetHeapStats(ph, &st);
+	for (i = 0; i < 16; ++i)
+		n += bin[i];
+
+	if (2 != st.freecnt || 2 != n || st.maxfree < RCL_SIZ / 2 || 14 != st.lenhist[0] || 2 != st.lenhist[1])
+		return false;
+#ifdef NM_STATS
+	if (2 != st.cnt.usedcnt || 3 != st.cnt.allocs || 1 != st.cnt.frees || 3 != st.cnt.splits)
+		return false;
+	/* Sizes are counted in the tag layout of the build, 32-bit under NM_COMPACT. */
+	if (nmSizeHeap(p[0]) + nmSizeHeap(p[2]) != st.cnt.usedsiz)
+		return false;
+#endif
+	return true;
+}
+
+/* Function name: _tsCountChunk
+ * Description:   Walk callback. Count chunks and free chunks.
+ * Parameters:
+ *        ptr Pointer to payload.
+ *       size Usable size.
+ *      bfree Whether the chunk is free.
+ *     pparam Pointer to an array of two counters.
+ * Return value:  0 to go on.
+ */
+int _tsCountChunk(void * ptr, size_t size, bool bfree, void * pparam)
+{
+	(void)ptr;
+	(void)size;
+	++((size_t *)pparam)[0];
+	((size_t *)pparam)[1] += bfree;
+	return 0;
+}
+
+/* Function name: tsCheck
+ * Description:   Walk a heap, check it whole and in slices, then find planted corruptions.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsCheck(void)
+{
+	P_HEAP_HEADER ph;
+	size_t cnt[2] = { 0 }, cur = 0, i;
+	TS_WORD * pt, t;
+	void * p[8];
+
+	ph = nmCreateHeap(rbuf, RCL_SIZ, 16);
+	if (NULL == ph)
+		return false;
+
+	for (i = 0; i < 8; ++i)
+		p[i] = nmAllocHeap(ph, 100);
+	for (i = 1; i < 7; i += 2)
+		nmFreeHeap(ph, p[i]);
+
+	/* 5 used blocks, 3 holes and the free tail. */
+	if (0 != nmWalkHeap(ph, _tsCountChunk, cnt) || 9 != cnt[0] || 4 != cnt[1])
+		return false;
+	if (HC_OK != nmCheckHeap(ph))
+		return false;
+	for (i = 0; i < 5; ++i)
+		if (HC_OK != nmCheckHeapSlice(ph, &cur, 2))
+			return false;
+	if (0 != cur)
+		return false;
+
+	/* Boundary tags differ. */
+	pt = (TS_WORD *)((char *)p[0] + nmSizeHeap(p[0]));
+	t = *pt;
+	*pt ^= 2 * sizeof(TS_WORD);
+	if (HC_BAD_TAG != nmCheckHeap(ph))
+		return false;
+	*pt = t;
+
+	/* A hole links to itself while its bin holds other holes too. */
+	pt = (TS_WORD *)p[1];
+	t = pt[1];
+#ifdef NM_OFFSETS
+	pt[1] = (TS_WORD)((char *)p[1] - (char *)ph);
+#else
+	pt[1] = (TS_WORD)p[1];
+#endif
+	if (HC_BAD_LINK != nmCheckHeap(ph))
+		return false;
+	pt[1] = t;
+
+	/* A used block is marked free next to a hole. */
+	pt = (TS_WORD *)p[2];
+	pt[-1] |= 1;
+	*(TS_WORD *)((char *)p[2] + nmSizeHeap(p[2])) |= 1;
+	if (HC_ADJ_FREE != nmCheckHeap(ph))
+		return false;
+	pt[-1] &= ~(TS_WORD)1;
+	*(TS_WORD *)((char *)p[2] + nmSizeHeap(p[2])) &= ~(TS_WORD)1;
+
+	return HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: _tsRegion
+ * Description:   Region provider. Hand out rbuf piece by piece.
+ * Parameters:
+ *       size Size of the region.
+ *       pend End of the heap.
+ *     pparam Pointer to the count of regions handed out.
+ * Return value:  pend or NULL.
+ */
+void * _tsRegion(size_t size, void * pend, void * pparam)
+{
+	if (size > (size_t)(rbuf + RCL_SIZ - (char *)pend))
+		return NULL;
+	++*(size_t *)pparam;
+	return pend;
+}
+
+/* Function name: tsGrow
+ * Description:   Let a small heap grow through a region provider.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsGrow(void)
+{
+	P_HEAP_HEADER ph;
+	size_t i, calls = 0;
+
+	if (NULL == (ph = nmCreateHeap(rbuf, 1024, 16)) || nmSetHeapProvider(ph, _tsRegion, &calls))
+		return false;
+	if (NULL == (ph = nmCreateHeapEx(rbuf, 1024, 16, HF_GROW)) || NULL != nmAllocHeap(ph, 2048))
+		return false;
+	if (!nmSetHeapProvider(ph, _tsRegion, &calls))
+		return false;
+
+	/* Far more than the first 1024 bytes. The heap doubles, so it takes few regions.
+	 * Doubling must not run out of rbuf, whatever the size of the heap header is.
+	 */
+	for (i = 0; i < 150; ++i)
+		if (NULL == nmAllocHeap(ph, 200))
+			return false;
+	if (calls > 7 || ph->size < 150 * 200)
+		return false;
+	if (HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* When rbuf runs out, so does the heap. */
+	return NULL == nmAllocHeap(ph, RCL_SIZ) && HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: _tsScatter
+ * Description:   Region provider. Hand out pieces of rbuf aligned to 64 with a gap before each one.
+ * Parameters:
+ *       size Size of the region.
+ *       pend End of the heap.
+ *     pparam Pointer to the first byte that is not handed out.
+ * Return value:  Pointer to a region or NULL.
+ */
+void * _tsScatter(size_t size, void * pend, void * pparam)
+{
+	char * p = (char *)(((size_t)*(char **)pparam + 64 + 63) & ~(size_t)63);
+
+	(void)pend;
+	if (size > (size_t)(rbuf + RCL_SIZ - p))
+		return NULL;
+	*(char **)pparam = p + size;
+	return p;
+}
+
+/* Function name: tsSegment
+ * Description:   Grow a heap with regions that do not touch, then free everything.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsSegment(void)
+{
+	P_HEAP_HEADER ph;
+	size_t cnt[2] = { 0 }, cur = 0, i, size;
+	char * pnext = rbuf + 1024;
+	void * p[BAT_CNT];
+
+	if (NULL == (ph = nmCreateHeapEx(rbuf, 1024, 16, HF_GROW)) || !nmSetHeapProvider(ph, _tsScatter, &pnext))
+		return false;
+	size = ph->size;
+
+	for (i = 0; i < BAT_CNT; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, 200)))
+			return false;
+	if (size != ph->size || HC_OK != nmCheckHeap(ph))
+		return false;
+	for (i = 0; i < BAT_CNT; ++i)
+		memset(p[i], (int)i, 200);
+
+	/* Merges stop at the sentinels, so each segment ends up as one free chunk. */
+	for (i = 0; i < BAT_CNT; ++i)
+		nmFreeHeap(ph, p[i]);
+	if (0 != nmWalkHeap(ph, _tsCountChunk, cnt) || cnt[0] != cnt[1] || cnt[0] < 3)
+		return false;
+	for (i = 0; i < cnt[0]; ++i)
+		if (HC_OK != nmCheckHeapSlice(ph, &cur, 1))
+			return false;
+	if (0 != cur || HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* A broken sentinel is found. It follows the two words of the first segment header. */
+	pnext = (char *)(((size_t)rbuf + 1024 + 64 + 63) & ~(size_t)63);
+	((size_t *)pnext)[2] |= 1;
+	return HC_BAD_TAG == nmCheckHeap(ph);
+}
+
+/* Function name: _tsPurge
+ * Description:   Page purger. Clear the pages, as the system may do, and count them.
+ * Parameters:
+ *          p Pointer to the first page.
+ *       size Size of the pages.
+ *     pparam Pointer to the count of bytes purged.
+ * Return value:  N/A.
+ */
+void _tsPurge(void * p, size_t size, void * pparam)
+{
+	memset(p, 0, size);
+	*(size_t *)pparam += size;
+}
+
+/* Function name: tsTrim
+ * Description:   Purge the holes of a heap by hand and lazily.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsTrim(void)
+{
+	P_HEAP_HEADER ph;
+	size_t i, n = 0;
+	void * p[16];
+
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_GROW)) || !nmSetHeapProvider(ph, NULL, &n))
+		return false;
+	if (nmSetHeapPurger(ph, _tsPurge, 1000, 0) || !nmSetHeapPurger(ph, _tsPurge, 1024, 0))
+		return false;
+
+	for (i = 0; i < 16; ++i)
+	{
+		if (NULL == (p[i] = nmAllocHeap(ph, 3000)))
+			return false;
+		memset(p[i], 0xab, 3000);
+	}
+	for (i = 0; i < 16; i += 2)
+		nmFreeHeap(ph, p[i]);
+
+	/* Nothing is purged while every free byte is kept, and there is no lazy purge. */
+	if (0 != nmTrimHeap(ph, RCL_SIZ) || 0 != n)
+		return false;
+
+	/* Each hole holds at least one page. Purged chunks are skipped the next time. */
+	if ((i = nmTrimHeap(ph, 0)) < 8 * 1024 || i != n || 0 != nmTrimHeap(ph, 0))
+		return false;
+	if (HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* Purged chunks are allocated like any other. */
+	for (i = 0; i < 16; i += 2)
+		if (NULL == (p[i] = nmAllocHeap(ph, 3000)))
+			return false;
+	if (HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* Holes of 3000 bytes count for the lazy purge. A pass runs once PURGE_LAZY * 2048 bytes were freed. */
+	if (!nmSetHeapPurger(ph, _tsPurge, 1024, 2048))
+		return false;
+	n = 0;
+	nmFreeHeap(ph, p[0]);
+	nmFreeHeap(ph, p[2]);
+	if (0 != n)
+		return false;
+	for (i = 4; i < 16; i += 2)
+		nmFreeHeap(ph, p[i]);
+	return 0 != n && HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: _tsRemap
+ * Description:   Mapper of huge blocks on top of the C library. Count live mappings.
+ * Parameters:
+ *          p Pointer to a mapping or NULL.
+ *     oldsiz Size of the mapping at p.
+ *     newsiz New size. 0 unmaps p.
+ *     pparam Pointer to the count of live mappings.
+ * Return value:  NULL: Unmapped or failed.
+ *                Pointer to the mapping: Succeeded.
+ */
+void * _tsRemap(void * p, size_t oldsiz, size_t newsiz, void * pparam)
+{
+	char * r;
+
+	if (0 == newsiz)
+	{
+		free(p);
+		--*(size_t *)pparam;
+		return NULL;
+	}
+	if (NULL == p)
+	{
+		if (NULL != (r = calloc(1, newsiz)))
+			++*(size_t *)pparam;
+		return r;
+	}
+	if (NULL != (r = realloc(p, newsiz)) && newsiz > oldsiz)
+		memset(r + oldsiz, 0, newsiz - oldsiz);
+	return r;
+}
+
+/* Function name: tsMap
+ * Description:   Map huge blocks of a small heap on their own, resize and free them.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsMap(void)
+{
+	P_HEAP_HEADER ph;
+	size_t i, n = 0;
+	unsigned char * p, * q;
+	void * pb[3];
+
+	if (NULL == (ph = nmCreateHeapEx(rbuf, 4096, 16, HF_GROW)) || !nmSetHeapProvider(ph, NULL, &n))
+		return false;
+	if (nmSetHeapMapper(ph, _tsRemap, 100, 8192) || !nmSetHeapMapper(ph, _tsRemap, 256, 8192))
+		return false;
+
+	/* Far bigger than the heap. */
+	if (NULL == (p = nmAllocHeap(ph, 100000)) || nmSizeHeap(p) < 100000 || 1 != n)
+		return false;
+	for (i = 0; i < 100000; ++i)
+		p[i] = (unsigned char)i;
+	if (NULL == (q = nmCallocHeap(ph, 1000, 50)) || 2 != n)
+		return false;
+	for (i = 0; i < 50000; ++i)
+		if (0 != q[i])
+			return false;
+
+	/* Remapped blocks keep their bytes. Blocks under the threshold go back into the heap. */
+	if (NULL == (p = nmReallocHeap(ph, p, 300000)))
+		return false;
+	for (i = 0; i < 100000; ++i)
+		if ((unsigned char)i != p[i])
+			return false;
+	if (NULL == (p = nmReallocHeap(ph, p, 1000)) || (char *)p < rbuf || (char *)p >= rbuf + 4096 || 1 != n)
+		return false;
+	for (i = 0; i < 1000; ++i)
+		if ((unsigned char)i != p[i])
+			return false;
+
+	/* A batch may mix both kinds. */
+	pb[0] = p;
+	pb[1] = q;
+	pb[2] = nmAllocHeap(ph, 16);
+	nmFreeBatch(ph, pb, 3);
+
+	return 0 == n && HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: tsAttach
+ * Description:   Move a heap to another address, attach it there and go on using it.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsAttach(void)
+{
+	P_HEAP_HEADER ph;
+	char * pnew = rbuf + RCL_SIZ / 2;
+
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ / 2, 16, HF_TLSF | HF_SLI(2))))
+		return false;
+#ifdef NM_OFFSETS
+	{
+		size_t i, j, off[8];
+		char * p;
+
+		for (i = 0; i < 8; ++i)
+		{
+			if (NULL == (p = nmAllocHeap(ph, 100 + i * 300)))
+				return false;
+			memset(p, (int)i, 100 + i * 300);
+			off[i] = (size_t)(p - rbuf);
+		}
+		for (i = 0; i < 8; i += 2)
+			nmFreeHeap(ph, rbuf + off[i]);
+
+		/* Wipe the old copy, so that nothing can lead back to it. */
+		memcpy(pnew, rbuf, RCL_SIZ / 2);
+		memset(rbuf, 0xff, RCL_SIZ / 2);
+		if (NULL != nmAttachHeap(pnew, 64) || NULL == (ph = nmAttachHeap(pnew, RCL_SIZ / 2)) || HC_OK != nmCheckHeap(ph))
+			return false;
+
+		/* Blocks are found at the same offsets. */
+		for (i = 1; i < 8; i += 2)
+		{
+			p = pnew + off[i];
+			for (j = 0; j < 100 + i * 300; ++j)
+				if ((int)i != p[j])
+					return false;
+			nmFreeHeap(ph, p);
+		}
+		for (i = 0; i < 8; ++i)
+			if (NULL == (p = nmAllocHeap(ph, 3000)) || p < pnew || p >= pnew + RCL_SIZ / 2)
+				return false;
+		return HC_OK == nmCheckHeap(ph);
+	}
+#else
+	/* Links are pointers into the old copy. */
+	memcpy(pnew, rbuf, RCL_SIZ / 2);
+	return NULL == nmAttachHeap(pnew, RCL_SIZ / 2);
+#endif
+}
+
+/* Function name: tsPlace
+ * Description:   Check which chunk each placement policy takes.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsPlace(void)
+{
+	P_HEAP_HEADER ph;
+	void * p[6], * q;
+	size_t i, seed = 5;
+
+	/* The last entrance would hold chunks too small for the tree. */
+	if (NULL != nmCreateHeapEx(rbuf, RCL_SIZ, 2, HF_BEST))
+		return false;
+
+	/* Address order: the lowest of three equal chunks is taken, whatever order they were freed in. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_ADDRESS)))
+		return false;
+	for (i = 0; i < 6; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, 64)))
+			return false;
+	nmFreeHeap(ph, p[4]);
+	nmFreeHeap(ph, p[0]);
+	nmFreeHeap(ph, p[2]);
+	if (p[0] != nmAllocHeap(ph, 64) || p[2] != nmAllocHeap(ph, 64))
+		return false;
+
+	/* Best fit in a list: the smaller chunk is taken although the bigger one is the head. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_BEST)))
+		return false;
+	for (i = 0; i < 4; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, i % 2 ? 16 : 112 - i * 16)))
+			return false;
+	nmFreeHeap(ph, p[2]);
+	nmFreeHeap(ph, p[0]);
+	if (p[2] != nmAllocHeap(ph, 72))
+		return false;
+
+	/* Best fit in the tree, which holds every chunk of 48 bytes and more. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 3, HF_BEST)))
+		return false;
+	for (i = 0; i < 6; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, i % 2 ? 16 : 400 - i * 50)))
+			return false;
+	nmFreeHeap(ph, p[0]);
+	nmFreeHeap(ph, p[2]);
+	nmFreeHeap(ph, p[4]);
+	if (p[4] != nmAllocHeap(ph, 180) || p[2] != nmAllocHeap(ph, 250) || p[0] != nmAllocHeap(ph, 260))
+		return false;
+
+	/* The tree must stay whole through a mixed workload. */
+	for (i = 0; i < RCL_OPS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		q = nmAllocHeap(ph, 1 + (seed >> 16) % 512);
+		if (NULL != q && (seed >> 8) % 3)
+			nmFreeHeap(ph, q);
+		if (0 == i % 1000 && HC_OK != nmCheckHeap(ph))
+			return false;
+	}
+	return HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: tsQuick
+ * Description:   Check that quick lists hand freed blocks back and are flushed when they must.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsQuick(void)
+{
+	P_HEAP_HEADER ph;
+	HEAP_STATS st;
+	void * p[4], * pb[ALN_CNT], * q;
+	size_t i, n, seed = 7;
+
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_NONE)) || nmSetHeapQuick(ph, 8))
+		return false;
+
+	/* Two neighbours wait unmerged and come back last in first out. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_QUICK)))
+		return false;
+	for (i = 0; i < 4; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, 40)))
+			return false;
+	nmFreeHeap(ph, p[1]);
+	nmFreeHeap(ph, p[2]);
+	st.pbin = NULL;
+	nmGetHeapStats(ph, &st);
+	if (2 != st.quickcnt || st.quicksiz < 80 || 1 != st.freecnt || HC_OK != nmCheckHeap(ph))
+		return false;
+	if (p[2] != nmAllocHeap(ph, 40) || p[1] != nmAllocHeap(ph, 33))
+		return false;
+
+	/* Turning them off merges their blocks. */
+	nmFreeHeap(ph, p[1]);
+	nmFreeHeap(ph, p[2]);
+	if (!nmSetHeapQuick(ph, 0))
+		return false;
+	nmGetHeapStats(ph, &st);
+	if (0 != st.quickcnt || 2 != st.freecnt || p[1] != nmAllocHeap(ph, 80) || HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* A full heap flushes them before it gives up. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, 1024, 4, HF_QUICK)))
+		return false;
+	for (n = 0; n < ALN_CNT && NULL != (pb[n] = nmAllocHeap(ph, 32)); ++n)
+		;
+	if (n < 4 || n == ALN_CNT)
+		return false;
+	for (i = 0; i < n; ++i)
+		nmFreeHeap(ph, pb[i]);
+	nmGetHeapStats(ph, &st);
+	if (n != st.quickcnt || NULL == nmAllocHeap(ph, n * 32) || HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* Reaching the limit flushes them too. */
+	if (NULL == (ph = nmCreateHeapEx(rbuf, RCL_SIZ, 16, HF_TLSF | HF_SLI(2) | HF_QUICK)) || !nmSetHeapQuick(ph, 3))
+		return false;
+	for (i = 0; i < 3; ++i)
+		if (NULL == (pb[i] = nmAllocHeap(ph, 16 + i * 16)))
+			return false;
+	for (i = 0; i < 3; ++i)
+		nmFreeHeap(ph, pb[i]);
+	nmGetHeapStats(ph, &st);
+	if (0 != st.quickcnt || 1 != st.freecnt)
+		return false;
+
+	/* Lists and bins must agree through a mixed workload. */
+	for (i = 0; i < RCL_OPS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		q = nmAllocHeap(ph, 1 + (seed >> 16) % ((seed >> 4) % 4 ? 96 : 1024));
+		if (NULL != q && (seed >> 8) % 3)
+			nmFreeHeap(ph, q);
+		if (0 == i % 1000 && HC_OK != nmCheckHeap(ph))
+			return false;
+	}
+	return HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: tsSlab
+ * Description:   Check slot alignment, return of empty runs and routing of big objects to the heap.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsSlab(void)
+{
+	P_HEAP_HEADER ph;
+	P_SLAB_HEADER ps;
+	HEAP_STATS st;
+	void * p[SLAB_MAX];
+	size_t i, free0, free1;
+
+	/* Runs are aligned blocks, so the heap starts on an aligned address. */
+	i = (size_t)(-(ptrdiff_t)sbuf & 63);
+	if (NULL == (ph = nmCreateHeap(sbuf + i, SLB_SIZ - 64, 16)))
+		return false;
+	st.pbin = NULL;
+	nmGetHeapStats(ph, &st);
+	free0 = st.freesiz;
+	if (NULL == (ps = nmCreateSlab(ph)))
+		return false;
+
+	/* Slots of every size are aligned like heap blocks. */
+	for (i = 0; i < SLAB_MAX; ++i)
+		if (NULL == (p[i] = nmAllocSlab(ps, i + 1)) || 0 != ((size_t)p[i] & (NM_ALIGN - 1)))
+			return false;
+	for (i = 0; i < SLAB_MAX; ++i)
+		nmFreeSlab(ps, p[i], i + 1);
+
+	/* Fill several runs of one class. Once they are empty, all but one go back to the heap. */
+	nmGetHeapStats(ph, &st);
+	free1 = st.freesiz;
+	for (i = 0; i < SLAB_MAX; ++i)
+		if (NULL == (p[i] = nmAllocSlab(ps, 64)))
+			return false;
+	nmGetHeapStats(ph, &st);
+	if (st.freesiz + 3 * SLAB_RUN > free1)
+		return false;
+	for (i = 0; i < SLAB_MAX; ++i)
+		nmFreeSlab(ps, p[i], 64);
+	nmGetHeapStats(ph, &st);
+	if (st.freesiz + SLAB_RUN < free1 || HC_OK != nmCheckHeap(ph))
+		return false;
+
+	/* Bigger objects are heap blocks, so one costs its own size and no run. */
+	free1 = st.freesiz;
+	if (NULL == (p[0] = nmAllocSlab(ps, SLAB_MAX + 1)) || nmSizeHeap(p[0]) < SLAB_MAX + 1)
+		return false;
+	nmGetHeapStats(ph, &st);
+	if (st.freesiz >= free1 || st.freesiz + SLAB_RUN / 2 <= free1)
+		return false;
+	nmFreeSlab(ps, p[0], SLAB_MAX + 1);
+
+	/* Destroying the slabs leaves the heap as it was. */
+	nmDestroySlab(ps);
+	nmGetHeapStats(ph, &st);
+	return 1 == st.freecnt && free0 == st.freesiz && HC_OK == nmCheckHeap(ph);
+}
+
+/* Function name: tsUnlink
+ * Description:   Unlink free chunks from the head, the middle and the tail of one long bin.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsUnlink(void)
+{
+	P_HEAP_HEADER ph;
+	HEAP_STATS st;
+	void * p[2 * ALN_CNT];
+	size_t i, k;
+
+	/* One entrance, so every hole lies in the same bin. */
+	if (NULL == (ph = nmCreateHeap(rbuf, RCL_SIZ, 1)))
+		return false;
+	for (i = 0; i < 2 * ALN_CNT; ++i)
+		if (NULL == (p[i] = nmAllocHeap(ph, 48)))
+			return false;
+	for (i = 0; i < 2 * ALN_CNT; i += 2)
+		nmFreeHeap(ph, p[i]);
+
+	/* Each used block merges with the holes on both sides, which sit anywhere in the list. */
+	st.pbin = NULL;
+	for (k = 0; k < ALN_CNT; ++k)
+	{
+		nmFreeHeap(ph, p[(k * 7 % ALN_CNT) * 2 + 1]);
+		nmGetHeapStats(ph, &st);
+		if (ALN_CNT - k != st.freecnt || HC_OK != nmCheckHeap(ph))
+			return false;
+	}
+	return NULL != nmAllocHeap(ph, RCL_SIZ / 2);
+}
+
+/* Function name: _tsRemoteFree
+ * Description:   Thread body of tsArena. Free a block of another arena, then allocate one.
+ * Parameter:
+ *     pparam Pointer to the arena set and the block to free. The new block replaces the freed one.
+ * Return value:  NULL.
+ */
+void * _tsRemoteFree(void * pparam)
+{
+	void ** pp = (void **)pparam;
+
+	nmFreeArenaSet((P_ARENA_SET)pp[0], pp[1]);
+	pp[1] = nmAllocArenaSet((P_ARENA_SET)pp[0], 64);
+	return NULL;
+}
+
+/* Function name: tsArena
+ * Description:   Find owners of blocks, free blocks from another thread and move a growing block between arenas.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsArena(void)
+{
+	P_ARENA_SET pas;
+	pthread_t tid;
+	void * pp[2], * pf, * pb;
+	unsigned char * p;
+	size_t i;
+	bool r;
+
+	if (NULL == (pas = nmCreateArenaSet(rbuf, RCL_SIZ, 2, 16)))
+		return false;
+
+	/* The first thread gets arena 0. Addresses out of the set have no owner. */
+	if (NULL == (p = nmAllocArenaSet(pas, 100)) || &pas->arena[0] != nmOwnerArena(pas, p) || NULL != nmOwnerArena(pas, buff))
+		return false;
+
+	/* A thread of arena 1 pushes a block of arena 0 onto its remote queue. */
+	pp[0] = pas;
+	if (NULL == (pf = pp[1] = nmAllocArenaSet(pas, 200)))
+		return false;
+	if (0 != pthread_create(&tid, NULL, _tsRemoteFree, pp) || 0 != pthread_join(tid, NULL))
+		return false;
+	if (NULL == pp[1] || &pas->arena[1] != nmOwnerArena(pas, pp[1]) || pf != atomic_load(&pas->arena[0].premote))
+		return false;
+
+	/* The next allocation in arena 0 drains the queue. */
+	if (NULL == (pb = nmAllocArenaSet(pas, 8)) || NULL != atomic_load(&pas->arena[0].premote))
+		return false;
+	nmFreeArenaSet(pas, pb);
+	nmFreeArenaSet(pas, pp[1]);
+
+	/* Arena 0 is full, so a growing block of it moves to arena 1. */
+	memset(p, 0x3c, 100);
+	while (NULL != nmAllocHeap(pas->arena[0].ph, 64))
+		;
+	if (NULL == (p = (unsigned char *)nmReallocArenaSet(pas, p, 1000)) || &pas->arena[1] != nmOwnerArena(pas, p))
+		return false;
+	for (i = 0; i < 100; ++i)
+		if (0x3c != p[i])
+			return false;
+	nmFreeArenaSet(pas, p);
+
+	r = HC_OK == nmCheckHeap(pas->arena[0].ph) && HC_OK == nmCheckHeap(pas->arena[1].ph);
+	nmDestroyArenaSet(pas);
+	return r;
+}
+
+/* Function name: _tsSyncWork
+ * Description:   Thread body of tsSync. Run a mixed workload on cached sizes, then exit with a full cache.
+ * Parameter:
+ *     pparam Pointer to thread-safe heap.
+ * Return value:  NULL: Passed. pparam: A block was overwritten while it was in use.
+ */
+void * _tsSyncWork(void * pparam)
+{
+	P_SYNC_HEAP psh = (P_SYNC_HEAP)pparam;
+	unsigned char * p[SYN_SLT] = { NULL };
+	void * pb[2 * TC_DEPTH];
+	size_t i, j, seed = (size_t)pparam;
+
+	for (i = 0; i < RCL_OPS / 4; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % SYN_SLT;
+		if (NULL != p[j])
+		{
+			if ((unsigned char)j != p[j][0] || (unsigned char)j != p[j][nmSizeHeap(p[j]) - 1])
+				return pparam;
+			nmFreeSyncHeap(psh, p[j]);
+			p[j] = NULL;
+		}
+		else if (NULL != (p[j] = (unsigned char *)nmAllocSyncHeap(psh, 1 + (seed >> 16) % (TC_CLASSES * TC_QUANTUM))))
+			memset(p[j], (int)j, nmSizeHeap(p[j]));
+	}
+
+	/* Overflow one class, so half of its cache goes back under the lock. */
+	for (i = 0; i < 2 * TC_DEPTH; ++i)
+		pb[i] = nmAllocSyncHeap(psh, TC_QUANTUM);
+	for (i = 0; i < 2 * TC_DEPTH; ++i)
+		nmFreeSyncHeap(psh, pb[i]);
+
+	/* Everything left in the cache is given back when the thread exits. */
+	for (j = 0; j < SYN_SLT; ++j)
+		nmFreeSyncHeap(psh, p[j]);
+	return NULL;
+}
+
+/* Function name: tsSync
+ * Description:   Share a thread-safe heap among threads and check that their caches go back to it.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsSync(void)
+{
+	P_SYNC_HEAP psh;
+	HEAP_STATS st;
+	pthread_t tid[SYN_THR];
+	void * pr, * p;
+	size_t i, free0;
+	bool r = true;
+
+	if (NULL == (psh = nmCreateSyncHeap(rbuf, RCL_SIZ, 16, 0)))
+		return false;
+	st.pbin = NULL;
+	nmGetHeapStats(psh->ph, &st);
+	free0 = st.freesiz;
+
+	for (i = 0; i < SYN_THR; ++i)
+		if (0 != pthread_create(&tid[i], NULL, _tsSyncWork, psh))
+			return false;
+	for (i = 0; i < SYN_THR; ++i)
+		if (0 != pthread_join(tid[i], &pr) || NULL != pr)
+			r = false;
+
+	/* Exited threads keep nothing, so the heap is whole again. */
+	nmGetHeapStats(psh->ph, &st);
+	if (!r || 1 != st.freecnt || free0 != st.freesiz || HC_OK != nmCheckHeap(psh->ph))
+		return false;
+
+	/* A block cached by this thread stays used after the heap is destroyed. The heap itself stays sound. */
+	if (NULL == (p = nmAllocSyncHeap(psh, TC_QUANTUM)))
+		return false;
+	nmFreeSyncHeap(psh, p);
+	nmDestroySyncHeap(psh);
+	nmGetHeapStats(psh->ph, &st);
+	return st.freesiz < free0 && HC_OK == nmCheckHeap(psh->ph) && NULL != nmAllocHeap(psh->ph, TC_QUANTUM);
+}
+
+/* Function name: tsTrace
+ * Description:   Record calls on a heap, load the trace and replay it on a heap sized by nmMeasureHeap.
+ * Parameter:     N/A.
+ * Return value:  true: Passed. false: Failed.
+ */
+bool tsTrace(void)
+{
+	P_HEAP_HEADER ph;
+	TRACE tr;
+	TRACE_DATA td;
+	REPLAY_RESULT rr;
+	void * p[RCL_SLT / 4] = { NULL };
+	size_t i, j, total, seed = 5;
+	bool r;
+
+	if (NULL == (ph = nmCreateHeap(rbuf, RCL_SIZ, 16)) || !nmOpenTrace(&tr, ph, TRC_NAM))
+		return false;
+	for (i = 0; i < TRC_OPS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % (RCL_SLT / 4);
+		if (NULL == p[j])
+			p[j] = nmTraceAllocHeap(&tr, 1 + (seed >> 16) % 256);
+		else if (seed & 0x10000)
+			p[j] = nmTraceReallocHeap(&tr, p[j], 1 + (seed >> 17) % 512);
+		else
+		{
+			nmTraceFreeHeap(&tr, p[j]);
+			p[j] = NULL;
+		}
+	}
+	nmCloseTrace(&tr);
+
+	if (!nmLoadTrace(&td, TRC_NAM))
+		return false;
+	remove(TRC_NAM);
+
+	/* Every call was recorded with the heap it ran on. */
+	total = nmMeasureHeap(td.size, td.hshsiz, td.flags);
+	r = TRC_OPS == td.count && ph->size == td.size && 16 == td.hshsiz && 0 != total && total <= SLB_SIZ;
+
+	/* The replay heap is at least as big as the recorded one, so every call succeeds again. */
+	if (r && NULL != (ph = nmCreateHeapEx(sbuf, total, td.hshsiz, td.flags)))
+		r = ph->size >= td.size && nmReplayTrace(&td, ph, &rr) && TRC_OPS == rr.ops && 0 == rr.fails &&
+			HC_OK == nmCheckHeap(ph);
+	else
+		r = false;
+
+	nmUnloadTrace(&td);
+	return r;
+}
 
 int main()
 {
 	P_HEAP_HEADER ph;
 	void * p1;
+	size_t r1, r2;
+
+	/* A heap with one entrance must reclaim as much as a heap with plenty of them. */
+	r1 = tsReclaim(1);
+	r2 = tsReclaim(64);
+	printf("Reclaimable bytes: %zu with 1 entrance, %zu with 64 entrances.\n", r1, r2);
+	if (r1 < r2 - r2 / 10)
+		return 5;
+
+	if (!tsRealloc())
+		return 6;
+
+	if (!tsAligned())
+		return 7;
+
+	if (!tsBatch())
+		return 8;
+
+	if (!tsCalloc())
+		return 9;
+
+	if (!tsStats())
+		return 10;
+
+	if (!tsCheck())
+		return 11;
+
+	if (!tsGrow())
+		return 12;
+
+	if (!tsSegment())
+		return 13;
+
+	if (!tsTrim())
+		return 14;
+
+	if (!tsMap())
+		return 15;
+
+	if (!tsAttach())
+		return 16;
+
+	if (!tsPlace())
+		return 17;
+
+	if (!tsQuick())
+		return 18;
+
+	if (!tsArena())
+		return 19;
+
+	if (!tsUnlink())
+		return 20;
+
+	if (!tsSlab())
+		return 21;
+
+	if (!tsSync())
+		return 22;
+
+	if (!tsTrace())
+		return 23;
 
 	memset(buff, 0xff, SIZ * 2);
 	
@@ -62,4 +1223,3 @@ int main()
 	}
 	return 1;
 }
-
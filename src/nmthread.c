@@ -0,0 +1,282 @@
+/*
+ * Name:        nmthread.c
+ * Description: Neo malloc thread-safe heaps.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262319H1510262328L00282
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nmthread.h"
+#include <string.h>  /* Using function memset. */
+
+/* [THREAD CACHE DIAGRAM]
+ * +==SYNC_HEAP==+
+ * | mtx         |<------ Taken only when a thread cache misses or overflows.
+ * | key         *------> Each thread has its own THREAD_CACHE, allocated from the heap.
+ * | ph          *---\
+ * +=HEAP_HEADER=+<--/
+ * |    ...      |
+ *
+ * +=THREAD_CACHE+
+ * | cnt[i]      |        Count of blocks in plist[i], at most TC_DEPTH.
+ * | plist[i]    *------> Block --> Block --> NULL.
+ * +=============+        Usable size of blocks in plist[i] is at least (i + 1) * TC_QUANTUM.
+ * Cached blocks stay used in the heap, so taking one needs no lock and no coalescing.
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+
+/* Per-thread cache structure. */
+typedef struct st_ThreadCache
+{
+	P_SYNC_HEAP psh;
+	size_t      cnt[TC_CLASSES];
+	void *      plist[TC_CLASSES];
+} THREAD_CACHE, * P_THREAD_CACHE;
+
+/* Usable macros. */
+#define NEXT_LINK(p)  (*(void **)(p))
+#define SYNC_SIZE     ((sizeof(SYNC_HEAP) + TC_QUANTUM - 1) / TC_QUANTUM * TC_QUANTUM)
+
+/* File level function declarations. */
+static void           _nmFlushCache (P_THREAD_CACHE ptc, size_t i, size_t n);
+static void           _nmDropCache  (void * pcache);
+static P_THREAD_CACHE _nmGetCache   (P_SYNC_HEAP psh);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmFlushCache
+ * Description:   Give cached blocks of one class back to the heap. Caller must hold the lock.
+ * Parameters:
+ *        ptc Pointer to thread cache.
+ *          i Class index.
+ *          n Count of blocks to give back.
+ * Return value:  N/A.
+ */
+static void _nmFlushCache(P_THREAD_CACHE ptc, size_t i, size_t n)
+{
+	register void * p;
+
+	while (n-- && NULL != (p = ptc->plist[i]))
+	{
+		ptc->plist[i] = NEXT_LINK(p);
+		--ptc->cnt[i];
+		nmFreeHeap(ptc->psh->ph, p);
+	}
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmDropCache
+ * Description:   Thread exit destructor. Give the whole cache back to the heap.
+ * Parameter:
+ *     pcache Pointer to thread cache.
+ * Return value:  N/A.
+ */
+static void _nmDropCache(void * pcache)
+{
+	register P_THREAD_CACHE ptc = (P_THREAD_CACHE)pcache;
+	register P_SYNC_HEAP psh = ptc->psh;
+	register size_t i;
+
+	pthread_mutex_lock(&psh->mtx);
+	for (i = 0; i < TC_CLASSES; ++i)
+		_nmFlushCache(ptc, i, TC_DEPTH);
+	nmFreeHeap(psh->ph, ptc);
+	pthread_mutex_unlock(&psh->mtx);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmGetCache
+ * Description:   Get the cache of the calling thread, create it on first use.
+ * Parameter:
+ *        psh Pointer to thread-safe heap.
+ * Return value:  Pointer to thread cache or NULL if the heap is exhausted.
+ */
+static P_THREAD_CACHE _nmGetCache(P_SYNC_HEAP psh)
+{
+	register P_THREAD_CACHE ptc = (P_THREAD_CACHE)pthread_getspecific(psh->key);
+
+	if (NULL == ptc)
+	{
+		pthread_mutex_lock(&psh->mtx);
+		ptc = (P_THREAD_CACHE)nmAllocHeap(psh->ph, sizeof(THREAD_CACHE));
+		pthread_mutex_unlock(&psh->mtx);
+
+		if (NULL != ptc)
+		{
+			memset(ptc, 0, sizeof(THREAD_CACHE));
+			ptc->psh = psh;
+			pthread_setspecific(psh->key, ptc);
+		}
+	}
+	return ptc;
+}
+
+/* Function name: nmCreateSyncHeap
+ * Description:   Create a thread-safe heap from a memory buffer.
+ * Parameters:
+ *      pbase Memory buffer starting address.
+ *       size Size of the whole buffer.(Unit in byte)
+ *     hshsiz Count of hash table entrances.
+ *      flags Heap creation flags, see nmCreateHeapEx.
+ * Return value:  NULL: Failed.
+ *                Pointer to thread-safe heap(same as pbase): Succeeded.
+ * Tip:           The heap itself starts right after SYNC_HEAP in the buffer.
+ */
+P_SYNC_HEAP nmCreateSyncHeap(void * pbase, size_t size, size_t hshsiz, size_t flags)
+{
+	register P_SYNC_HEAP psh = (P_SYNC_HEAP)pbase;
+
+	if (NULL == pbase || size < SYNC_SIZE)
+		return NULL;
+
+	psh->ph = nmCreateHeapEx((PUCHAR)pbase + SYNC_SIZE, size - SYNC_SIZE, hshsiz, flags);
+	if (NULL == psh->ph)
+		return NULL;
+
+	if (0 != pthread_mutex_init(&psh->mtx, NULL))
+		return NULL;
+
+	if (0 != pthread_key_create(&psh->key, _nmDropCache))
+	{
+		pthread_mutex_destroy(&psh->mtx);
+		return NULL;
+	}
+
+	return psh;
+}
+
+/* Function name: nmDestroySyncHeap
+ * Description:   Release the lock and the thread cache key of a thread-safe heap.
+ * Parameter:
+ *        psh Pointer to thread-safe heap.
+ * Return value:  N/A.
+ * Tip:           Blocks that are still cached by running threads stay used in the heap.
+ *                The buffer may be reused after calling this function.
+ */
+void nmDestroySyncHeap(P_SYNC_HEAP psh)
+{
+	pthread_key_delete(psh->key);
+	pthread_mutex_destroy(&psh->mtx);
+}
+
+/* Function name: nmAllocSyncHeap
+ * Description:   Thread-safe heap allocation.
+ * Parameters:
+ *        psh Pointer to thread-safe heap.
+ *       size Size in bytes you want to allocate.
+ * Return value:  NULL: Failed.
+ *                Pointer to a heap address: Succeeded.
+ */
+void * nmAllocSyncHeap(P_SYNC_HEAP psh, size_t size)
+{
+	register void * p;
+	register size_t i = (size + TC_QUANTUM - 1) / TC_QUANTUM;
+
+	if (0 != i && i <= TC_CLASSES)
+	{
+		register P_THREAD_CACHE ptc = _nmGetCache(psh);
+
+		/* Lock free fast path. */
+		if (NULL != ptc && NULL != (p = ptc->plist[i - 1]))
+		{
+			ptc->plist[i - 1] = NEXT_LINK(p);
+			--ptc->cnt[i - 1];
+			return p;
+		}
+		/* Ask for the full class size, so that the block can serve the class after being freed. */
+		size = i * TC_QUANTUM;
+	}
+
+	pthread_mutex_lock(&psh->mtx);
+	p = nmAllocHeap(psh->ph, size);
+	pthread_mutex_unlock(&psh->mtx);
+
+	return p;
+}
+
+/* Function name: nmFreeSyncHeap
+ * Description:   Thread-safe heap freedom.
+ * Parameters:
+ *        psh Pointer to thread-safe heap.
+ *        ptr Pointer in heap that you want to free.
+ * Return value:  N/A.
+ */
+void nmFreeSyncHeap(P_SYNC_HEAP psh, void * ptr)
+{
+	register size_t i;
+
+	if (NULL == ptr)
+		return;
+
+	i = nmSizeHeap(ptr) / TC_QUANTUM;
+
+	if (0 != i && i <= TC_CLASSES)
+	{
+		register P_THREAD_CACHE ptc = _nmGetCache(psh);
+
+		if (NULL != ptc)
+		{
+			--i;
+			if (TC_DEPTH == ptc->cnt[i])
+			{	/* Cache is full. Give half of it back in one lock. */
+				pthread_mutex_lock(&psh->mtx);
+				_nmFlushCache(ptc, i, TC_DEPTH / 2);
+				pthread_mutex_unlock(&psh->mtx);
+			}
+
+			/* Lock free fast path. */
+			NEXT_LINK(ptr) = ptc->plist[i];
+			ptc->plist[i] = ptr;
+			++ptc->cnt[i];
+			return;
+		}
+	}
+
+	pthread_mutex_lock(&psh->mtx);
+	nmFreeHeap(psh->ph, ptr);
+	pthread_mutex_unlock(&psh->mtx);
+}
+
+/* Function name: nmReallocSyncHeap
+ * Description:   Thread-safe heap reallocation.
+ * Parameters:
+ *        psh Pointer to thread-safe heap.
+ *        ptr Pointer in heap that you want to reallocate.
+ *       size New size of memory chunk.
+ * Return value:  NULL: Reallocation failed.
+ *                Pointer to heap memory: Succeeded.
+ */
+void * nmReallocSyncHeap(P_SYNC_HEAP psh, void * ptr, size_t size)
+{
+	register void * p;
+
+	if (NULL == ptr)
+		return nmAllocSyncHeap(psh, size);
+	else if (0 == size)
+	{
+		nmFreeSyncHeap(psh, ptr);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&psh->mtx);
+	p = nmReallocHeap(psh->ph, ptr, size);
+	pthread_mutex_unlock(&psh->mtx);
+
+	return p;
+}
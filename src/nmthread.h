@@ -0,0 +1,50 @@
+/*
+ * Name:        nmthread.h
+ * Description: Neo malloc thread-safe heaps.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262319G1510262321L00050
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMTHREAD_H_
+#define _NMTHREAD_H_
+
+#include "neomalloc.h"
+#include <limits.h>  /* Using macro CHAR_BIT. */
+#include <pthread.h> /* Using type pthread_mutex_t and pthread_key_t. */
+
+#define TC_QUANTUM (sizeof(size_t) * CHAR_BIT / 4) /* Size step of thread cache classes. */
+#define TC_CLASSES 32  /* Blocks up to TC_CLASSES * TC_QUANTUM bytes are cached. */
+#define TC_DEPTH   32  /* The most blocks that one thread keeps for one class. */
+
+/* Thread-safe heap structure. */
+typedef struct st_SyncHeap
+{
+	pthread_mutex_t mtx; /* Lock of the heap. */
+	pthread_key_t   key; /* Per-thread cache of this heap. */
+	P_HEAP_HEADER   ph;  /* The heap which follows this structure. */
+} SYNC_HEAP, * P_SYNC_HEAP;
+
+/* Exported functions. */
+P_SYNC_HEAP nmCreateSyncHeap  (void *      pbase, size_t size, size_t hshsiz, size_t flags);
+void        nmDestroySyncHeap (P_SYNC_HEAP psh);
+void *      nmAllocSyncHeap   (P_SYNC_HEAP psh,   size_t size);
+void        nmFreeSyncHeap    (P_SYNC_HEAP psh,   void * ptr);
+void *      nmReallocSyncHeap (P_SYNC_HEAP psh,   void * ptr,  size_t size);
+
+#endif
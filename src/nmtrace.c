@@ -0,0 +1,605 @@
+/*
+ * Name:        nmtrace.c
+ * Description: Neo malloc trace recording and replay.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262345L1610260015L00605
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "nmtrace.h"
+#include <stdlib.h>  /* Using function calloc, realloc, free. */
+#include <string.h>  /* Using function memcmp, memcpy, memset. */
+#include <time.h>    /* Using function timespec_get. */
+
+/* [TRACE FILE DIAGRAM]
+ * +====HEADER===+
+ * | "NMTR"      |        4 bytes of magic.
+ * | version     |        1 byte, TR_VERSION.
+ * | size        |        Varint. ph->size of the recorded heap.
+ * | hshsiz      |        Varint.
+ * | flags       |        Varint.
+ * +====RECORD===+
+ * | op          |        1 byte, en_TraceOp.
+ * | tick        |        Varint. Nanoseconds since the previous record.
+ * | size        |        Varint. TO_ALLOC and TO_REALLOC only.
+ * | hdl         |        Varint. Offset of the block from the heap header modulo 2^N, 0 for NULL.
+ * | hnew        |        Varint. TO_REALLOC only.
+ * +=============+
+ * | ...         |        Records follow up to the end of the file.
+ * A varint holds 7 bits per byte, low bits first. The high bit is set on every byte but the last.
+ * A handle is only unique among live blocks. Blocks of segments or mappings may lie anywhere,
+ * so replay maps handles to its own blocks by a hash table, which grows with the live blocks only.
+ */
+
+/* sizeof(UCHART) == 1. */
+typedef unsigned char * PUCHAR;
+typedef unsigned char   UCHART;
+
+/* Usable macros. */
+#define TR_MAGIC   "NMTR"
+#define TR_VERSION 1
+#define TR_VARINT  10    /* The most bytes of a varint. */
+#define RP_STEP    65536 /* Replayed operations between two fragmentation samples. */
+#define RP_MAPMIN  1024  /* Initial slots of the handle table of replay. */
+#define HANDLE(pt, p) (NULL == (p) ? 0 : (size_t)((PUCHAR)(p) - (PUCHAR)(pt)->ph))
+
+/* Handle table of replay. Open addressing with linear probing. */
+typedef struct st_ReplayMap
+{
+	size_t * pkey; /* Handles. 0 marks an empty slot. */
+	void **  pval; /* Blocks of replay that the handles stand for. */
+	size_t   cap;  /* Count of slots, a power of two. */
+	size_t   cnt;  /* Count of handles in the table. */
+} REPLAY_MAP, * P_REPLAY_MAP;
+
+/* File level function declarations. */
+static unsigned long long _nmNow       (void);
+static size_t             _nmPutVarint (PUCHAR p, unsigned long long n);
+static bool               _nmGetVarint (FILE * fp, unsigned long long * pn);
+static void               _nmPutRecord (P_TRACE pt, size_t op, size_t size, size_t hdl, size_t hnew);
+static bool               _nmGetRecord (FILE * fp, P_TRACE_RECORD prec);
+static void               _nmTakeBlock (P_REPLAY_RESULT prr, P_HEAP_HEADER ph, void * ptr, size_t * pused);
+static size_t             _nmMapHome   (P_REPLAY_MAP pm, size_t hdl);
+static size_t             _nmMapSlot   (P_REPLAY_MAP pm, size_t hdl);
+static bool               _nmMapPut    (P_REPLAY_MAP pm, size_t hdl, void * ptr);
+static void *             _nmMapTake   (P_REPLAY_MAP pm, size_t hdl);
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmNow
+ * Description:   Get current time in nanoseconds.
+ * Parameter:     N/A.
+ * Return value:  Time stamp in nanoseconds.
+ */
+static unsigned long long _nmNow(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPutVarint
+ * Description:   Encode an integer as a varint.
+ * Parameters:
+ *          p Pointer to a buffer of at least TR_VARINT bytes.
+ *          n The integer.
+ * Return value:  Count of bytes written.
+ */
+static size_t _nmPutVarint(PUCHAR p, unsigned long long n)
+{
+	register size_t i = 0;
+
+	for ( ; n >= 0x80; n >>= 7)
+		p[i++] = (UCHART)(n | 0x80);
+	p[i++] = (UCHART)n;
+
+	return i;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmGetVarint
+ * Description:   Decode a varint from a file.
+ * Parameters:
+ *         fp Pointer to file.
+ *         pn Receives the integer.
+ * Return value:  true: Succeeded. false: The file ends or the varint is too long.
+ */
+static bool _nmGetVarint(FILE * fp, unsigned long long * pn)
+{
+	register size_t i;
+	register int c;
+
+	*pn = 0;
+	for (i = 0; i < TR_VARINT; ++i)
+	{
+		if (EOF == (c = fgetc(fp)))
+			return false;
+		*pn |= (unsigned long long)(c & 0x7f) << (7 * i);
+		if (!(c & 0x80))
+			return true;
+	}
+	return false;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmPutRecord
+ * Description:   Append one record to a trace file.
+ * Parameters:
+ *         pt Pointer to trace recorder.
+ *         op One of en_TraceOp.
+ *       size Size asked for.
+ *        hdl Handle of the block.
+ *       hnew Handle of the result of TO_REALLOC.
+ * Return value:  N/A.
+ */
+static void _nmPutRecord(P_TRACE pt, size_t op, size_t size, size_t hdl, size_t hnew)
+{
+	UCHART buf[1 + 4 * TR_VARINT];
+	register size_t n = 0;
+	register unsigned long long t = _nmNow();
+
+	buf[n++] = (UCHART)op;
+	n += _nmPutVarint(buf + n, t - pt->last);
+	if (TO_FREE != op)
+		n += _nmPutVarint(buf + n, size);
+	n += _nmPutVarint(buf + n, hdl);
+	if (TO_REALLOC == op)
+		n += _nmPutVarint(buf + n, hnew);
+	pt->last = t;
+
+	fwrite(buf, 1, n, pt->fp);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmGetRecord
+ * Description:   Read one record from a trace file.
+ * Parameters:
+ *         fp Pointer to file.
+ *       prec Receives the record.
+ * Return value:  true: Succeeded. false: The file ends or the record is broken.
+ */
+static bool _nmGetRecord(FILE * fp, P_TRACE_RECORD prec)
+{
+	unsigned long long n;
+	register int c;
+
+	if (EOF == (c = fgetc(fp)) || c < TO_ALLOC || c > TO_REALLOC)
+		return false;
+	memset(prec, 0, sizeof(TRACE_RECORD));
+	prec->op = (size_t)c;
+
+	if (!_nmGetVarint(fp, &prec->tick))
+		return false;
+	if (TO_FREE != prec->op)
+	{
+		if (!_nmGetVarint(fp, &n))
+			return false;
+		prec->size = (size_t)n;
+	}
+	if (!_nmGetVarint(fp, &n))
+		return false;
+	prec->hdl = (size_t)n;
+	if (TO_REALLOC == prec->op)
+	{
+		if (!_nmGetVarint(fp, &n))
+			return false;
+		prec->hnew = (size_t)n;
+	}
+	return true;
+}
+
+/* Function name: nmOpenTrace
+ * Description:   Start recording the calls on a heap.
+ * Parameters:
+ *         pt Pointer to trace recorder.
+ *         ph Pointer to heap header.
+ *       path Name of the trace file. It is truncated.
+ * Return value:  true: Succeeded. false: Failed.
+ * Tip:           Calls take their part in the trace only through nmTraceAllocHeap, nmTraceFreeHeap and
+ *                nmTraceReallocHeap. The recorder is not thread-safe; share it under the lock of the heap.
+ */
+bool nmOpenTrace(P_TRACE pt, P_HEAP_HEADER ph, const char * path)
+{
+	UCHART buf[sizeof(TR_MAGIC) + 3 * TR_VARINT];
+	register size_t n = sizeof(TR_MAGIC) - 1;
+
+	if (NULL == (pt->fp = fopen(path, "wb")))
+		return false;
+	pt->ph = ph;
+	pt->last = _nmNow();
+
+	memcpy(buf, TR_MAGIC, n);
+	buf[n++] = TR_VERSION;
+	n += _nmPutVarint(buf + n, ph->size);
+	n += _nmPutVarint(buf + n, ph->hshsiz);
+	n += _nmPutVarint(buf + n, ph->flags & ~(size_t)(HF_PADDED | HF_OFFSETS | HF_COMPACT));
+
+	if (n != fwrite(buf, 1, n, pt->fp))
+	{
+		fclose(pt->fp);
+		return false;
+	}
+	return true;
+}
+
+/* Function name: nmCloseTrace
+ * Description:   Stop recording and close the trace file.
+ * Parameter:
+ *         pt Pointer to trace recorder.
+ * Return value:  N/A.
+ */
+void nmCloseTrace(P_TRACE pt)
+{
+	fclose(pt->fp);
+	pt->fp = NULL;
+}
+
+/* Function name: nmTraceAllocHeap
+ * Description:   Call nmAllocHeap and record it.
+ * Parameters:
+ *         pt Pointer to trace recorder.
+ *       size Size in bytes you want to allocate.
+ * Return value:  Same as nmAllocHeap.
+ */
+void * nmTraceAllocHeap(P_TRACE pt, size_t size)
+{
+	register void * p = nmAllocHeap(pt->ph, size);
+
+	_nmPutRecord(pt, TO_ALLOC, size, HANDLE(pt, p), 0);
+	return p;
+}
+
+/* Function name: nmTraceFreeHeap
+ * Description:   Call nmFreeHeap and record it.
+ * Parameters:
+ *         pt Pointer to trace recorder.
+ *        ptr Pointer in heap that you want to free.
+ * Return value:  N/A.
+ */
+void nmTraceFreeHeap(P_TRACE pt, void * ptr)
+{
+	if (NULL == ptr)
+		return;
+
+	_nmPutRecord(pt, TO_FREE, 0, HANDLE(pt, ptr), 0);
+	nmFreeHeap(pt->ph, ptr);
+}
+
+/* Function name: nmTraceReallocHeap
+ * Description:   Call nmReallocHeap and record it.
+ * Parameters:
+ *         pt Pointer to trace recorder.
+ *        ptr Pointer in heap that you want to reallocate.
+ *       size New size of memory chunk.
+ * Return value:  Same as nmReallocHeap.
+ * Tip:           A call that acts as nmAllocHeap or nmFreeHeap is recorded as one.
+ */
+void * nmTraceReallocHeap(P_TRACE pt, void * ptr, size_t size)
+{
+	register void * p;
+
+	if (NULL == ptr)
+		return nmTraceAllocHeap(pt, size);
+	else if (0 == size)
+	{
+		nmTraceFreeHeap(pt, ptr);
+		return NULL;
+	}
+
+	p = nmReallocHeap(pt->ph, ptr, size);
+	_nmPutRecord(pt, TO_REALLOC, size, HANDLE(pt, ptr), HANDLE(pt, p));
+	return p;
+}
+
+/* Function name: nmLoadTrace
+ * Description:   Read a whole trace file into memory.
+ * Parameters:
+ *        ptd Pointer to loaded trace. Release it by nmUnloadTrace.
+ *       path Name of the trace file.
+ * Return value:  true: Succeeded. false: Failed.
+ * Tip:           A broken last record, as left by a process that died while recording, is dropped.
+ */
+bool nmLoadTrace(P_TRACE_DATA ptd, const char * path)
+{
+	UCHART buf[sizeof(TR_MAGIC)];
+	unsigned long long n[3];
+	size_t cap = 0;
+	register P_TRACE_RECORD pr;
+	register FILE * fp;
+
+	memset(ptd, 0, sizeof(TRACE_DATA));
+	if (NULL == (fp = fopen(path, "rb")))
+		return false;
+
+	if (sizeof(buf) != fread(buf, 1, sizeof(buf), fp) || 0 != memcmp(buf, TR_MAGIC, sizeof(buf) - 1) ||
+		TR_VERSION != buf[sizeof(buf) - 1] || !_nmGetVarint(fp, &n[0]) || !_nmGetVarint(fp, &n[1]) || !_nmGetVarint(fp, &n[2]))
+	{
+		fclose(fp);
+		return false;
+	}
+	ptd->size   = (size_t)n[0];
+	ptd->hshsiz = (size_t)n[1];
+	ptd->flags  = (size_t)n[2];
+
+	for ( ; ; )
+	{
+		if (ptd->count == cap)
+		{
+			cap = 0 == cap ? 4096 : cap * 2;
+			if (NULL == (pr = (P_TRACE_RECORD)realloc(ptd->prec, cap * sizeof(TRACE_RECORD))))
+			{
+				fclose(fp);
+				nmUnloadTrace(ptd);
+				return false;
+			}
+			ptd->prec = pr;
+		}
+		pr = &ptd->prec[ptd->count];
+		if (!_nmGetRecord(fp, pr))
+			break;
+		++ptd->count;
+	}
+
+	fclose(fp);
+	return true;
+}
+
+/* Function name: nmUnloadTrace
+ * Description:   Release a loaded trace.
+ * Parameter:
+ *        ptd Pointer to loaded trace.
+ * Return value:  N/A.
+ */
+void nmUnloadTrace(P_TRACE_DATA ptd)
+{
+	free(ptd->prec);
+	memset(ptd, 0, sizeof(TRACE_DATA));
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmTakeBlock
+ * Description:   Account a block that replay has just got.
+ * Parameters:
+ *        prr Pointer to replay result.
+ *         ph Pointer to heap header.
+ *        ptr Pointer to the block.
+ *      pused Pointer to the count of bytes in used blocks.
+ * Return value:  N/A.
+ */
+static void _nmTakeBlock(P_REPLAY_RESULT prr, P_HEAP_HEADER ph, void * ptr, size_t * pused)
+{
+	register size_t t = nmSizeHeap(ptr);
+
+	if ((*pused += t) > prr->peakused)
+		prr->peakused = *pused;
+	t += (size_t)((PUCHAR)ptr - (PUCHAR)ph);
+	if (t > prr->peakfoot)
+		prr->peakfoot = t;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMapHome
+ * Description:   Get the slot where the probe for a handle starts.
+ * Parameters:
+ *         pm Pointer to handle table.
+ *        hdl Handle.
+ * Return value:  Index of the slot.
+ */
+static size_t _nmMapHome(P_REPLAY_MAP pm, size_t hdl)
+{
+	register unsigned long long h = (unsigned long long)hdl;
+
+	/* Handles are multiples of ALIGN. Spread them before they are cut to the table. */
+	h = (h ^ (h >> 29)) * 0x9e3779b97f4a7c15ULL;
+	return (size_t)(h >> 32) & (pm->cap - 1);
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMapSlot
+ * Description:   Find the slot of a handle, or the empty slot where it would go.
+ * Parameters:
+ *         pm Pointer to handle table. It has an empty slot.
+ *        hdl Handle. Not 0.
+ * Return value:  Index of the slot.
+ */
+static size_t _nmMapSlot(P_REPLAY_MAP pm, size_t hdl)
+{
+	register size_t i;
+
+	for (i = _nmMapHome(pm, hdl); 0 != pm->pkey[i] && hdl != pm->pkey[i]; i = (i + 1) & (pm->cap - 1))
+		;
+	return i;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMapPut
+ * Description:   Map a handle to a block. The table doubles when it becomes half full.
+ * Parameters:
+ *         pm Pointer to handle table.
+ *        hdl Handle. Not 0.
+ *        ptr Pointer to the block.
+ * Return value:  true: Succeeded. false: Out of memory.
+ */
+static bool _nmMapPut(P_REPLAY_MAP pm, size_t hdl, void * ptr)
+{
+	REPLAY_MAP m;
+	register size_t i, j;
+
+	if (2 * (pm->cnt + 1) > pm->cap)
+	{
+		m.cap = 0 == pm->cap ? RP_MAPMIN : 2 * pm->cap;
+		m.cnt = pm->cnt;
+		m.pkey = (size_t *)calloc(m.cap, sizeof(size_t));
+		m.pval = (void **)malloc(m.cap * sizeof(void *));
+		if (NULL == m.pkey || NULL == m.pval)
+		{
+			free(m.pkey);
+			free(m.pval);
+			return false;
+		}
+		for (i = 0; i < pm->cap; ++i)
+		{
+			if (0 != pm->pkey[i])
+			{
+				j = _nmMapSlot(&m, pm->pkey[i]);
+				m.pkey[j] = pm->pkey[i];
+				m.pval[j] = pm->pval[i];
+			}
+		}
+		free(pm->pkey);
+		free(pm->pval);
+		*pm = m;
+	}
+
+	i = _nmMapSlot(pm, hdl);
+	if (0 == pm->pkey[i])
+		++pm->cnt;
+	pm->pkey[i] = hdl;
+	pm->pval[i] = ptr;
+	return true;
+}
+
+/* Attention:     This Is An Internal Function. No Interface for Library Users.
+ * Function name: _nmMapTake
+ * Description:   Remove a handle from the table.
+ * Parameters:
+ *         pm Pointer to handle table.
+ *        hdl Handle.
+ * Return value:  Pointer to the block of the handle, or NULL if the table does not hold it.
+ */
+static void * _nmMapTake(P_REPLAY_MAP pm, size_t hdl)
+{
+	register size_t i, j, k;
+	register void * p;
+
+	if (0 == pm->cnt || 0 == hdl || 0 == pm->pkey[i = _nmMapSlot(pm, hdl)])
+		return NULL;
+	p = pm->pval[i];
+
+	/* Shift later entries of the probe run back into the hole, unless their home lies behind it. */
+	for (j = i; ; )
+	{
+		j = (j + 1) & (pm->cap - 1);
+		if (0 == pm->pkey[j])
+			break;
+		k = _nmMapHome(pm, pm->pkey[j]);
+		if (((j - k) & (pm->cap - 1)) >= ((j - i) & (pm->cap - 1)))
+		{
+			pm->pkey[i] = pm->pkey[j];
+			pm->pval[i] = pm->pval[j];
+			i = j;
+		}
+	}
+	pm->pkey[i] = 0;
+	--pm->cnt;
+	return p;
+}
+
+/* Function name: nmReplayTrace
+ * Description:   Run a loaded trace against a heap.
+ * Parameters:
+ *        ptd Pointer to loaded trace.
+ *         ph Pointer to a fresh heap. It need not match the recorded one.
+ *        prr Pointer to replay result.
+ * Return value:  true: Succeeded. false: Out of memory for the handle table.
+ * Tip:           Calls that failed when recorded are skipped, so the same trace
+ *                stays valid for a bigger heap. Time is measured across heap calls only.
+ *                Fragmentation is sampled every RP_STEP operations outside the timing.
+ *                Blocks that the trace never frees stay in the heap.
+ */
+bool nmReplayTrace(P_TRACE_DATA ptd, P_HEAP_HEADER ph, P_REPLAY_RESULT prr)
+{
+	register size_t i, j, k;
+	register P_TRACE_RECORD pr;
+	register void * p, * q;
+	register bool bok = true;
+	size_t used = 0;
+	REPLAY_MAP map;
+	unsigned long long t;
+	HEAP_STATS st;
+
+	memset(prr, 0, sizeof(REPLAY_RESULT));
+	memset(&map, 0, sizeof(REPLAY_MAP));
+
+	for (i = 0; i < ptd->count; ++i)
+		prr->span += (double)ptd->prec[i].tick;
+	prr->span /= 1e9;
+
+	st.pbin = NULL;
+	for (i = 0; i < ptd->count; )
+	{
+		j = ptd->count - i > RP_STEP ? i + RP_STEP : ptd->count;
+		t = _nmNow();
+		for ( ; i < j; ++i)
+		{
+			pr = &ptd->prec[i];
+			switch (pr->op)
+			{
+			case TO_ALLOC:
+				if (0 == pr->hdl)
+					continue;
+				if (NULL == (p = nmAllocHeap(ph, pr->size)))
+				{
+					++prr->fails;
+					break;
+				}
+				_nmTakeBlock(prr, ph, p, &used);
+				bok = _nmMapPut(&map, pr->hdl, p);
+				break;
+			case TO_FREE:
+				if (NULL != (q = _nmMapTake(&map, pr->hdl)))
+				{
+					used -= nmSizeHeap(q);
+					nmFreeHeap(ph, q);
+				}
+				break;
+			case TO_REALLOC:
+				if (0 == pr->hnew)
+					continue;
+				q = _nmMapTake(&map, pr->hdl);
+				k = NULL == q ? 0 : nmSizeHeap(q);
+				if (NULL == (p = nmReallocHeap(ph, q, pr->size)))
+				{	/* The old block stays under its handle. */
+					++prr->fails;
+					bok = NULL == q || _nmMapPut(&map, pr->hdl, q);
+					break;
+				}
+				used -= k;
+				_nmTakeBlock(prr, ph, p, &used);
+				bok = _nmMapPut(&map, pr->hnew, p);
+				break;
+			}
+			if (!bok)
+			{
+				free(map.pkey);
+				free(map.pval);
+				return false;
+			}
+			++prr->ops;
+		}
+		prr->seconds += (double)(_nmNow() - t) / 1e9;
+
+		nmGetHeapStats(ph, &st);
+		if (0 != st.freesiz && 1.0 - (double)st.maxfree / (double)st.freesiz > prr->maxfrag)
+			prr->maxfrag = 1.0 - (double)st.maxfree / (double)st.freesiz;
+	}
+
+	free(map.pkey);
+	free(map.pval);
+	return true;
+}
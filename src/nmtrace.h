@@ -0,0 +1,88 @@
+/*
+ * Name:        nmtrace.h
+ * Description: Neo malloc trace recording and replay.
+ * Author:      cosh.cage#hotmail.com
+ * File ID:     1510262345K1610260047L00088
+ * License:     LGPLv3
+ * Copyright (C) 2025 John Cage
+ *
+ * This file is part of Neo Malloc.
+ *
+ * Neo Malloc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any later version.
+ *
+ * Neo Malloc is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License along with StoneValley.
+ * If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _NMTRACE_H_
+#define _NMTRACE_H_
+
+#include "neomalloc.h"
+#include <stdio.h>  /* Using type FILE. */
+
+/* Trace operations. */
+enum en_TraceOp
+{
+	TO_ALLOC   = 1, /* nmAllocHeap. */
+	TO_FREE    = 2, /* nmFreeHeap. */
+	TO_REALLOC = 3  /* nmReallocHeap. */
+};
+
+/* Trace recorder structure. */
+typedef struct st_Trace
+{
+	FILE *             fp;    /* Trace file. */
+	P_HEAP_HEADER      ph;    /* Recorded heap. */
+	unsigned long long last;  /* Time stamp of the last record in nanoseconds. */
+} TRACE, * P_TRACE;
+
+/* Trace record structure. */
+typedef struct st_TraceRecord
+{
+	size_t             op;    /* One of en_TraceOp. */
+	size_t             size;  /* Size asked for. 0 for TO_FREE. */
+	size_t             hdl;   /* Handle of the block that is freed or reallocated, or of the new block. */
+	size_t             hnew;  /* TO_REALLOC only: handle of the result. */
+	unsigned long long tick;  /* Nanoseconds since the previous record. */
+} TRACE_RECORD, * P_TRACE_RECORD;
+
+/* Loaded trace structure. */
+typedef struct st_TraceData
+{
+	size_t             size;   /* ph->size of the recorded heap when recording began. */
+	size_t             hshsiz; /* Count of hash table entrances of the recorded heap. */
+	size_t             flags;  /* Creation flags of the recorded heap. */
+	size_t             count;  /* Count of records. */
+	P_TRACE_RECORD     prec;   /* Records. */
+} TRACE_DATA, * P_TRACE_DATA;
+
+/* Replay result structure. */
+typedef struct st_ReplayResult
+{
+	size_t             ops;      /* Count of operations replayed. */
+	size_t             fails;    /* Operations that failed in replay but succeeded when recorded. */
+	size_t             peakused; /* The most bytes in used blocks at a time. */
+	size_t             peakfoot; /* The highest end of a used block, as an offset from the heap header. */
+	double             maxfrag;  /* The worst 1 - maxfree / freesiz seen while replaying. */
+	double             seconds;  /* Time spent in heap calls. */
+	double             span;     /* Time the recorded workload took. */
+} REPLAY_RESULT, * P_REPLAY_RESULT;
+
+/* Exported functions. */
+bool   nmOpenTrace       (P_TRACE      pt,  P_HEAP_HEADER ph,   const char * path);
+void   nmCloseTrace      (P_TRACE      pt);
+void * nmTraceAllocHeap  (P_TRACE      pt,  size_t size);
+void   nmTraceFreeHeap   (P_TRACE      pt,  void * ptr);
+void * nmTraceReallocHeap(P_TRACE      pt,  void * ptr,         size_t size);
+bool   nmLoadTrace       (P_TRACE_DATA ptd, const char * path);
+void   nmUnloadTrace     (P_TRACE_DATA ptd);
+bool   nmReplayTrace     (P_TRACE_DATA ptd, P_HEAP_HEADER ph,   P_REPLAY_RESULT prr);
+
+#endif